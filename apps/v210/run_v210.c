@@ -16,6 +16,8 @@
 #include <V120.h>
 
 #include "v210.h"
+#include "v210_matrix.h"
+#include "v210_sequencer.h"
 
 /***************************************************************************************************
  * DEFINES
@@ -195,24 +197,35 @@ int main(int argc, char* argv[]) {
     if (channel_mask != 0x0000000000000000) printf("Error: Not all relays are OFF\n");
   }
 
-  /** Sequentially set each relay with a delay. */
+  /** Sequentially set each relay, then clear each relay, on a 250 ms deadline schedule. */
+  uint64_t step_masks[2 * V210_CHANNEL_COUNT];
+  v210_sequence_step_t steps[2 * V210_CHANNEL_COUNT];
   channel_mask = 0;
-  for (int i = 0; i < V210_CHANNEL_COUNT; i++) {
-    channel_mask |= (1ULL << i);
-    if (v210_set_relays(v210_region, channel_mask) < 0) {
-      printf("Error: Failed to set relay for channel %d\n", i);
-    }
-    usleep(250000);
-  }
-
-  /** Sequentially clear each relay with a delay. */
-  for (int i = V210_CHANNEL_COUNT - 1; i >= 0; i--) {
-    channel_mask &= ~(1ULL << i);
-    if (v210_set_relays(v210_region, channel_mask) < 0) {
-      printf("Error: Failed to clear relay for channel %d\n", i);
+  for (int i = 0; i < 2 * V210_CHANNEL_COUNT; i++) {
+    if (i < V210_CHANNEL_COUNT) channel_mask |= (1ULL << i);
+    else channel_mask &= ~(1ULL << (2 * V210_CHANNEL_COUNT - 1 - i));
+    step_masks[i] = channel_mask;
+    steps[i].offset_ns = (uint64_t)i * 250000000ULL;
+    steps[i].masks = &step_masks[i];
+  }
+
+  v210_matrix_t* matrix = v210_matrix_create(hV120, &v210_region, 1);
+  v210_sequencer_t* sequencer = NULL;
+  if (matrix != NULL) sequencer = v210_sequencer_create(matrix, steps, 2 * V210_CHANNEL_COUNT);
+  if (sequencer == NULL) {
+    printf("Error: Failed to create relay sequencer\n");
+  } else if (v210_sequencer_start(sequencer) < 0) {
+    printf("Error: Failed to start relay sequencer\n");
+  } else {
+    if (v210_sequencer_wait(sequencer) < 0) printf("Error: Relay sequence failed\n");
+    v210_sequence_report_t report;
+    if (v210_sequencer_get_report(sequencer, &report) == 0) {
+      printf("Relay sequence: %zu steps, %zu writes, max lateness %" PRIu64 " ns\n",
+          report.steps_executed, report.writes_issued, report.max_lateness_ns);
     }
-    usleep(250000);
   }
+  v210_sequencer_delete(sequencer);
+  v210_matrix_delete(matrix);
 
   if (v210_disable_relay_drivers(v210_region) < 0) {
     printf("Error: Failed to disable relay drivers\n");
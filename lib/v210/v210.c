@@ -6,12 +6,15 @@
  * INCLUDES
  **************************************************************************************************/
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "v210.h"
+#include "v210_journal.h"
 #include "v210_reg.h"
+#include "v210_wear.h"
 
 /***************************************************************************************************
  * DEFINES
@@ -19,10 +22,39 @@
 
 #define V210_CHANNELS_PER_REGISTER 16
 
+/** Alignment of region storage. */
+#define V210_CACHE_LINE_SIZE 64
+
+#define V210_CTL_REGISTER_COUNT V210_RELAY_WORD_COUNT
+
+/** Interval between rcon[] polls while verifying relay contacts. */
+#define V210_VERIFY_POLL_INTERVAL_NS 100000L
+
 /***************************************************************************************************
  * TYPES
  **************************************************************************************************/
 
+/** V210 Per-Region Data. Kept to a few cache lines; the settle statistics live out of line. */
+typedef struct v210_region_data_t {
+  /** Shadow of ctl[0..3] as last written or read, valid once ctl_valid is set. */
+  uint16_t ctl[V210_CTL_REGISTER_COUNT];
+  bool ctl_valid;
+  /** Time of the last ctl[] write that changed a relay (CLOCK_MONOTONIC). */
+  uint64_t last_change_ns;
+  /** Relays changed since the last successful verification. */
+  uint64_t unverified_mask;
+  /** Optional settle statistics of all relays. */
+  v210_settle_stats_t* settle_stats;
+  /** Optional persistent relay actuation counters. */
+  v210_wear_t* wear;
+  /** Optional crash-safe journal of commanded relay states. */
+  v210_journal_t* journal;
+  /** Shadow of csr, valid once csr_valid is set. Guarded by csr_lock. */
+  pthread_mutex_t csr_lock;
+  uint16_t csr;
+  bool csr_valid;
+} v210_region_data_t;
+
 /***************************************************************************************************
  * VARIABLES
  **************************************************************************************************/
@@ -34,6 +66,12 @@ struct timespec relay_settling_time = {0, 10 * 1000000L};
  * IMPLEMENTATION
  **************************************************************************************************/
 
+uint64_t v210_get_time_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
 /**
  * Validates the VME address and addressing mode for the V210 module.
  * 
@@ -56,30 +94,66 @@ static int v210_validate_address_and_mode(const V120_PD addr_mode, const uint32_
   return 0;
 }
 
+/**
+ * Gets the offset of the per-region data within the storage of a region.
+ *
+ * @return Offset in bytes, a multiple of the cache line size.
+ */
+static inline size_t v210_region_data_offset(void) {
+  return (sizeof(VME_REGION) + V210_CACHE_LINE_SIZE - 1) & ~(size_t)(V210_CACHE_LINE_SIZE - 1);
+}
+
+size_t v210_get_region_storage_size(void) {
+  const size_t size = v210_region_data_offset() + sizeof(v210_region_data_t);
+  return (size + V210_CACHE_LINE_SIZE - 1) & ~(size_t)(V210_CACHE_LINE_SIZE - 1);
+}
+
 VME_REGION* v210_add_region(V120_HANDLE* restrict hV120, const uint32_t vme_addr, 
     const V120_PD addr_mode, const char* restrict name) {
 
-  if (v210_validate_address_and_mode(addr_mode, vme_addr) < 0) return NULL;
-  
-  VME_REGION* v210_region = malloc(sizeof(VME_REGION));
-  if (v210_region == NULL) {
+  /** The region, its data and its settle statistics share one cache-aligned allocation. */
+  const size_t storage_size = v210_get_region_storage_size();
+  void* storage = aligned_alloc(V210_CACHE_LINE_SIZE,
+      storage_size + V210_CHANNEL_COUNT * sizeof(v210_settle_stats_t));
+  if (storage == NULL) {
     printf("v210_add_region: Failed to allocate memory for VME_REGION\n");
     return NULL;
   }
 
+  VME_REGION* v210_region = v210_add_region_at(hV120, vme_addr, addr_mode, name, storage);
+  if (v210_region == NULL) {
+    free(storage);
+    return NULL;
+  }
+  v210_attach_settle_stats(v210_region, (v210_settle_stats_t*)((char*)storage + storage_size));
+  return v210_region;
+}
+
+VME_REGION* v210_add_region_at(V120_HANDLE* restrict hV120, const uint32_t vme_addr,
+    const V120_PD addr_mode, const char* restrict name, void* restrict storage) {
+
+  if (storage == NULL || ((uintptr_t)storage % V210_CACHE_LINE_SIZE) != 0) return NULL;
+  if (v210_validate_address_and_mode(addr_mode, vme_addr) < 0) return NULL;
+
+  VME_REGION* v210_region = (VME_REGION*)storage;
+  v210_region_data_t* region_data =
+      (v210_region_data_t*)((char*)storage + v210_region_data_offset());
+
   memset(v210_region, 0, sizeof(VME_REGION));
+  memset(region_data, 0, sizeof(v210_region_data_t));
+  pthread_mutex_init(&region_data->csr_lock, NULL);
   v210_region->base = NULL;
   v210_region->start_page = v210_region->end_page = 0;
   v210_region->vme_addr = vme_addr;
   v210_region->len = sizeof(v210_registers);
   v210_region->config = addr_mode | V120_SMAX | V120_EAUTO | V120_RW | V120_D16;
   v210_region->tag = name;
-  v210_region->udata = NULL;
+  v210_region->udata = (void *)region_data;
 
   VME_REGION* data = v120_add_vme_region(hV120, v210_region);
   if (data == NULL) {
-    printf("v210_add_region: Failed to add VME region\n");
-    free(v210_region);
+    printf("v210_add_region_at: Failed to add VME region\n");
+    v210_release_region(v210_region);
     return NULL;
   }
 
@@ -101,7 +175,19 @@ int v210_print_region_info(VME_REGION* v210_region) {
 }
 
 void v210_delete_region(VME_REGION* restrict v210_region) {
-  if (v210_region != NULL) free(v210_region);
+  if (v210_region == NULL) return;
+  v210_release_region(v210_region);
+  free(v210_region);
+}
+
+void v210_release_region(VME_REGION* restrict v210_region) {
+  if (v210_region == NULL) return;
+  if (v210_region->udata != NULL) {
+    v210_wear_close(((v210_region_data_t *)v210_region->udata)->wear);
+    v210_journal_close(((v210_region_data_t *)v210_region->udata)->journal);
+    pthread_mutex_destroy(&((v210_region_data_t *)v210_region->udata)->csr_lock);
+    v210_region->udata = NULL;
+  }
 }
 
 /**
@@ -114,6 +200,16 @@ static inline volatile v210_registers* v210_get_registers(VME_REGION* restrict v
   return (v210_registers *)v210_region->base;
 }
 
+/**
+ * Gets a pointer to the per-region data of the V210 module.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @return Pointer to the per-region data.
+ */
+static inline v210_region_data_t* v210_get_region_data(VME_REGION* restrict v210_region) {
+  return (v210_region_data_t *)v210_region->udata;
+}
+
 /***************************************************************************************************
  * V210 Overhead Information
  **************************************************************************************************/
@@ -146,16 +242,39 @@ int v210_get_fpga_rev(VME_REGION* restrict v210_region, uint16_t* rev) {
  * V210 Error LED 
  **************************************************************************************************/
 
-int v210_turn_off_error_led(VME_REGION* restrict v210_region) {
+/**
+ * Updates bits of the csr register with a single write, using the csr shadow for the other bits.
+ * The shadow is loaded from the hardware on first use.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  set_bits    Bits to set.
+ * @param  clear_bits  Bits to clear.
+ * @return 0 on success, non-zero on failure.
+ */
+static int v210_update_csr_bits(VME_REGION* restrict v210_region, uint16_t set_bits, 
+    uint16_t clear_bits) {
   if (v210_region == NULL) return -1;
-  v210_get_registers(v210_region)->csr |= V210_CSR_ERR_LED;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL) return -1;
+  volatile v210_registers* regs = v210_get_registers(v210_region);
+  pthread_mutex_lock(&region_data->csr_lock);
+  if (!region_data->csr_valid) {
+    region_data->csr = regs->csr;
+    region_data->csr_valid = true;
+  }
+  uint16_t csr = (uint16_t)((region_data->csr | set_bits) & ~clear_bits);
+  regs->csr = csr;
+  region_data->csr = csr;
+  pthread_mutex_unlock(&region_data->csr_lock);
   return 0;
 }
 
+int v210_turn_off_error_led(VME_REGION* restrict v210_region) {
+  return v210_update_csr_bits(v210_region, V210_CSR_ERR_LED, 0);
+}
+
 int v210_turn_on_error_led(VME_REGION* restrict v210_region) {
-  if (v210_region == NULL) return -1;
-  v210_get_registers(v210_region)->csr &= ~V210_CSR_ERR_LED;
-  return 0;
+  return v210_update_csr_bits(v210_region, 0, V210_CSR_ERR_LED);
 }
 
 int v210_is_error_led_on(VME_REGION* restrict v210_region, bool* is_on) {
@@ -169,14 +288,31 @@ int v210_is_error_led_on(VME_REGION* restrict v210_region, bool* is_on) {
  **************************************************************************************************/
 
 int v210_enable_relay_drivers(VME_REGION* restrict v210_region) {
-  if (v210_region == NULL) return -1;
-  v210_get_registers(v210_region)->csr |= (V210_CSR_P4TM | V210_CSR_P3TM);
-  return 0;
+  return v210_update_csr_bits(v210_region, V210_CSR_P4TM | V210_CSR_P3TM, 0);
 }
 
 int v210_disable_relay_drivers(VME_REGION* restrict v210_region) {
+  return v210_update_csr_bits(v210_region, 0, V210_CSR_P4TM | V210_CSR_P3TM);
+}
+
+int v210_set_csr(VME_REGION* restrict v210_region, bool error_led_on, bool relay_drivers_enabled) {
+  /** The error LED is lit while its bit is clear. */
+  uint16_t set_bits = 0, clear_bits = 0;
+  if (error_led_on) clear_bits |= V210_CSR_ERR_LED;
+  else set_bits |= V210_CSR_ERR_LED;
+  if (relay_drivers_enabled) set_bits |= V210_CSR_P4TM | V210_CSR_P3TM;
+  else clear_bits |= V210_CSR_P4TM | V210_CSR_P3TM;
+  return v210_update_csr_bits(v210_region, set_bits, clear_bits);
+}
+
+int v210_sync_csr_shadow(VME_REGION* restrict v210_region) {
   if (v210_region == NULL) return -1;
-  v210_get_registers(v210_region)->csr &= ~(V210_CSR_P4TM | V210_CSR_P3TM);
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL) return -1;
+  pthread_mutex_lock(&region_data->csr_lock);
+  region_data->csr = v210_get_registers(v210_region)->csr;
+  region_data->csr_valid = true;
+  pthread_mutex_unlock(&region_data->csr_lock);
   return 0;
 }
 
@@ -196,25 +332,400 @@ int v210_is_p3tm_driver_enabled(VME_REGION* restrict v210_region, bool* is_enabl
  * V210 Relay Control 
  **************************************************************************************************/
 
-int v210_set_relays(VME_REGION* restrict v210_region, uint64_t channel_mask) {
-  if (v210_region == NULL) return -1;
+/**
+ * Splits a 64-bit channel mask into ctl[] register words. ctl[3] holds channels 0 - 15.
+ * 
+ * @param  channel_mask 64-bit channel mask.
+ * @param  words        Storage for the ctl[] register words.
+ */
+static inline void v210_mask_to_words(uint64_t channel_mask, uint16_t* restrict words) {
+  for (int8_t i = 0; i < V210_CTL_REGISTER_COUNT; i++) {
+    words[V210_CTL_REGISTER_COUNT - 1 - i] = (uint16_t)(channel_mask & 0xFFFF);
+    channel_mask >>= V210_CHANNELS_PER_REGISTER;
+  }
+}
+
+/**
+ * Joins ctl[] register words into a 64-bit channel mask. ctl[3] holds channels 0 - 15.
+ * 
+ * @param  words ctl[] register words.
+ * @return 64-bit channel mask.
+ */
+static inline uint64_t v210_words_to_mask(const uint16_t* restrict words) {
+  uint64_t channel_mask = 0;
+  for (int8_t i = 0; i < V210_CTL_REGISTER_COUNT; i++) {
+    channel_mask <<= V210_CHANNELS_PER_REGISTER;
+    channel_mask |= words[i];
+  }
+  return channel_mask;
+}
+
+/**
+ * Loads the ctl[] shadow from the hardware if it is not yet valid.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @return 0 on success, non-zero on failure.
+ */
+static int v210_load_relay_shadow(VME_REGION* restrict v210_region) {
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL) return -1;
+  if (region_data->ctl_valid) return 0;
   volatile v210_registers* regs = v210_get_registers(v210_region);
-  for (int8_t i = 0; i < 4; i++) {
-    regs->ctl[3 - i] = (uint16_t)(channel_mask & 0xFFFF);
-    channel_mask >>= 16;
+  for (int8_t i = 0; i < V210_CTL_REGISTER_COUNT; i++) region_data->ctl[i] = regs->ctl[i];
+  region_data->ctl_valid = true;
+  return 0;
+}
+
+/**
+ * Writes ctl[] register words and updates the shadow. Words are written from ctl[3] down to
+ * ctl[0]. Unless forced, only words that differ from the shadow are written. The shadow is loaded
+ * from the hardware first if needed, so every changed relay is counted by the wear counters.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  words       ctl[] register words to write.
+ * @param  force       If true, writes all words regardless of the shadow.
+ * @return 0 on success, non-zero on failure.
+ */
+static int v210_write_relay_words(VME_REGION* restrict v210_region, 
+    const uint16_t* restrict words, bool force) {
+  if (v210_load_relay_shadow(v210_region) < 0) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL) return -1;
+  volatile v210_registers* regs = v210_get_registers(v210_region);
+  uint16_t changed[V210_CTL_REGISTER_COUNT] = {0};
+  v210_journal_begin(region_data->journal, v210_words_to_mask(words));
+  for (int8_t i = V210_CTL_REGISTER_COUNT - 1; i >= 0; i--) {
+    if (!force && region_data->ctl[i] == words[i]) continue;
+    regs->ctl[i] = words[i];
+    changed[i] = region_data->ctl[i] ^ words[i];
+    region_data->ctl[i] = words[i];
+    v210_wear_record(region_data->wear, (uint8_t)i, changed[i]);
+  }
+  v210_journal_commit(region_data->journal);
+
+  uint64_t changed_mask = v210_words_to_mask(changed);
+  if (changed_mask != 0) {
+    const uint64_t now_ns = v210_get_time_ns();
+    region_data->last_change_ns = now_ns;
+    region_data->unverified_mask |= changed_mask;
+    /** Each relay settles from its own change, not from a later write to other relays. */
+    if (region_data->settle_stats != NULL) {
+      for (uint64_t mask = changed_mask; mask != 0; mask &= mask - 1) {
+        region_data->settle_stats[__builtin_ctzll(mask)].last_change_ns = now_ns;
+      }
+    }
   }
   return 0;
 }
 
+int v210_set_relays(VME_REGION* restrict v210_region, uint64_t channel_mask) {
+  if (v210_region == NULL) return -1;
+  uint16_t words[V210_CTL_REGISTER_COUNT];
+  v210_mask_to_words(channel_mask, words);
+  return v210_write_relay_words(v210_region, words, true);
+}
+
 int v210_get_relays(VME_REGION* restrict v210_region, bool let_relays_settle, uint64_t* mask) {
   if (v210_region == NULL) return -1;
   if (let_relays_settle) nanosleep(&relay_settling_time, NULL);
-  uint64_t channel_mask = 0;
+  uint16_t words[V210_CTL_REGISTER_COUNT];
   volatile v210_registers* regs = v210_get_registers(v210_region);
-  for (int8_t i = 0; i < 4; i++) {
-    channel_mask <<= 16;
-    channel_mask |= (regs->ctl[i] & 0xFFFF);
+  for (int8_t i = 0; i < V210_CTL_REGISTER_COUNT; i++) words[i] = regs->ctl[i];
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data != NULL) {
+    memcpy(region_data->ctl, words, sizeof(words));
+    region_data->ctl_valid = true;
   }
-  *mask = channel_mask;
+  *mask = v210_words_to_mask(words);
   return 0;
 }
+
+/***************************************************************************************************
+ * V210 Shadowed Relay Control
+ **************************************************************************************************/
+
+int v210_sync_relay_shadow(VME_REGION* restrict v210_region) {
+  if (v210_region == NULL) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL) return -1;
+  region_data->ctl_valid = false;
+  return v210_load_relay_shadow(v210_region);
+}
+
+int v210_get_commanded_relays(VME_REGION* restrict v210_region, uint64_t* restrict mask) {
+  if (v210_region == NULL) return -1;
+  if (v210_load_relay_shadow(v210_region) < 0) return -1;
+  *mask = v210_words_to_mask(v210_get_region_data(v210_region)->ctl);
+  return 0;
+}
+
+int v210_update_relays(VME_REGION* restrict v210_region, uint64_t channel_mask) {
+  if (v210_region == NULL) return -1;
+  uint16_t words[V210_CTL_REGISTER_COUNT];
+  v210_mask_to_words(channel_mask, words);
+  return v210_write_relay_words(v210_region, words, false);
+}
+
+int v210_write_relay_word(VME_REGION* restrict v210_region, uint8_t word, uint16_t value) {
+  if (v210_region == NULL || word >= V210_CTL_REGISTER_COUNT) return -1;
+  if (v210_load_relay_shadow(v210_region) < 0) return -1;
+  uint16_t words[V210_CTL_REGISTER_COUNT];
+  memcpy(words, v210_get_region_data(v210_region)->ctl, sizeof(words));
+  words[word] = value;
+  return v210_write_relay_words(v210_region, words, false);
+}
+
+int v210_set_relay_mask(VME_REGION* restrict v210_region, uint64_t channel_mask) {
+  uint64_t mask;
+  if (v210_get_commanded_relays(v210_region, &mask) < 0) return -1;
+  return v210_update_relays(v210_region, mask | channel_mask);
+}
+
+int v210_clear_relay_mask(VME_REGION* restrict v210_region, uint64_t channel_mask) {
+  uint64_t mask;
+  if (v210_get_commanded_relays(v210_region, &mask) < 0) return -1;
+  return v210_update_relays(v210_region, mask & ~channel_mask);
+}
+
+int v210_toggle_relay_mask(VME_REGION* restrict v210_region, uint64_t channel_mask) {
+  uint64_t mask;
+  if (v210_get_commanded_relays(v210_region, &mask) < 0) return -1;
+  return v210_update_relays(v210_region, mask ^ channel_mask);
+}
+
+int v210_set_relay(VME_REGION* restrict v210_region, uint8_t channel) {
+  if (channel >= V210_CHANNEL_COUNT) return -1;
+  return v210_set_relay_mask(v210_region, 1ULL << channel);
+}
+
+int v210_clear_relay(VME_REGION* restrict v210_region, uint8_t channel) {
+  if (channel >= V210_CHANNEL_COUNT) return -1;
+  return v210_clear_relay_mask(v210_region, 1ULL << channel);
+}
+
+int v210_toggle_relay(VME_REGION* restrict v210_region, uint8_t channel) {
+  if (channel >= V210_CHANNEL_COUNT) return -1;
+  return v210_toggle_relay_mask(v210_region, 1ULL << channel);
+}
+
+/***************************************************************************************************
+ * V210 Relay Contact Verification
+ **************************************************************************************************/
+
+int v210_get_contacts(VME_REGION* restrict v210_region, uint64_t* restrict mask) {
+  if (v210_region == NULL) return -1;
+  uint16_t words[V210_CTL_REGISTER_COUNT];
+  volatile v210_registers* regs = v210_get_registers(v210_region);
+  for (int8_t i = 0; i < V210_CTL_REGISTER_COUNT; i++) words[i] = regs->rcon[i];
+  *mask = v210_words_to_mask(words);
+  return 0;
+}
+
+/**
+ * Records the settle time of each relay in the mask, measured from the relay's last change.
+ * 
+ * @param  region_data Per-region data of the V210 module.
+ * @param  mask        Relays that have settled.
+ * @param  now_ns      Time at which the relays were seen settled.
+ */
+static void v210_record_settle_times(v210_region_data_t* restrict region_data, uint64_t mask, 
+    uint64_t now_ns) {
+  if (region_data->settle_stats == NULL) return;
+  while (mask != 0) {
+    int channel = __builtin_ctzll(mask);
+    mask &= mask - 1;
+    v210_settle_stats_t* stats = &region_data->settle_stats[channel];
+    const uint64_t settle_ns = now_ns - stats->last_change_ns;
+    if (stats->count == 0 || settle_ns < stats->min_ns) stats->min_ns = settle_ns;
+    if (settle_ns > stats->max_ns) stats->max_ns = settle_ns;
+    stats->total_ns += settle_ns;
+    stats->count++;
+  }
+}
+
+int v210_verify_relays(VME_REGION* restrict v210_region, uint32_t timeout_us, 
+    uint64_t* restrict settle_ns) {
+  if (v210_region == NULL) return -1;
+  if (v210_load_relay_shadow(v210_region) < 0) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  const uint64_t expected = v210_words_to_mask(region_data->ctl);
+  const uint64_t deadline_ns = v210_get_time_ns() + (uint64_t)timeout_us * 1000ULL;
+  const struct timespec poll_interval = {0, V210_VERIFY_POLL_INTERVAL_NS};
+
+  uint64_t pending = region_data->unverified_mask;
+  for (;;) {
+    uint64_t contacts;
+    v210_get_contacts(v210_region, &contacts);
+    uint64_t now_ns = v210_get_time_ns();
+    uint64_t elapsed_ns = now_ns - region_data->last_change_ns;
+
+    uint64_t mismatched = contacts ^ expected;
+    v210_record_settle_times(region_data, pending & ~mismatched, now_ns);
+    pending &= mismatched;
+
+    if (mismatched == 0) {
+      region_data->unverified_mask = 0;
+      if (settle_ns != NULL) *settle_ns = elapsed_ns;
+      return 0;
+    }
+    if (now_ns >= deadline_ns) {
+      /** Relays that settled have been recorded; only the rest stay unverified. */
+      region_data->unverified_mask = pending;
+      if (settle_ns != NULL) *settle_ns = elapsed_ns;
+      return -2;
+    }
+    nanosleep(&poll_interval, NULL);
+  }
+}
+
+int v210_attach_settle_stats(VME_REGION* restrict v210_region,
+    v210_settle_stats_t* restrict stats) {
+  if (v210_region == NULL || stats == NULL) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL || region_data->settle_stats != NULL) return -1;
+  memset(stats, 0, V210_CHANNEL_COUNT * sizeof(v210_settle_stats_t));
+  /** Relays already awaiting verification changed no later than the last write. */
+  for (uint8_t channel = 0; channel < V210_CHANNEL_COUNT; channel++) {
+    stats[channel].last_change_ns = region_data->last_change_ns;
+  }
+  region_data->settle_stats = stats;
+  return 0;
+}
+
+int v210_get_settle_stats(VME_REGION* restrict v210_region, uint8_t channel, 
+    v210_settle_stats_t* restrict stats) {
+  if (v210_region == NULL || channel >= V210_CHANNEL_COUNT) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL || region_data->settle_stats == NULL) return -1;
+  *stats = region_data->settle_stats[channel];
+  return 0;
+}
+
+int v210_reset_settle_stats(VME_REGION* restrict v210_region) {
+  if (v210_region == NULL) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL || region_data->settle_stats == NULL) return -1;
+  /** Change times are kept, so relays still awaiting verification settle from their change. */
+  for (uint8_t channel = 0; channel < V210_CHANNEL_COUNT; channel++) {
+    v210_settle_stats_t* stats = &region_data->settle_stats[channel];
+    *stats = (v210_settle_stats_t){ .last_change_ns = stats->last_change_ns };
+  }
+  return 0;
+}
+
+/***************************************************************************************************
+ * V210 Relay Transitions
+ **************************************************************************************************/
+
+int v210_switch_relays(VME_REGION* restrict v210_region, uint64_t old_mask, uint64_t new_mask, 
+    v210_switch_policy_t policy, uint32_t verify_timeout_us) {
+  if (v210_region == NULL) return -1;
+
+  const uint64_t opening = old_mask & ~new_mask;
+  const uint64_t closing = new_mask & ~old_mask;
+  uint64_t intermediate;
+  switch (policy) {
+    case V210_SWITCH_BREAK_BEFORE_MAKE: intermediate = old_mask & new_mask; break;
+    case V210_SWITCH_MAKE_BEFORE_BREAK: intermediate = old_mask | new_mask; break;
+    default:                            return -1;
+  }
+
+  /** A single phase suffices when the transition only opens or only closes relays. */
+  if (opening == 0 || closing == 0) return v210_update_relays(v210_region, new_mask);
+
+  if (v210_update_relays(v210_region, intermediate) < 0) return -1;
+  if (verify_timeout_us != 0) {
+    int status = v210_verify_relays(v210_region, verify_timeout_us, NULL);
+    if (status != 0) return status;
+  } else {
+    nanosleep(&relay_settling_time, NULL);
+  }
+  return v210_update_relays(v210_region, new_mask);
+}
+
+/***************************************************************************************************
+ * V210 Relay Wear Counters
+ **************************************************************************************************/
+
+int v210_attach_wear_counters(VME_REGION* restrict v210_region, const char* restrict directory) {
+  if (v210_region == NULL || directory == NULL) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL || region_data->wear != NULL) return -1;
+  uint16_t board_id;
+  if (v210_get_board_id(v210_region, &board_id) < 0) return -1;
+  region_data->wear = v210_wear_open(directory, board_id, (uint32_t)v210_region->vme_addr);
+  return (region_data->wear == NULL) ? -1 : 0;
+}
+
+int v210_detach_wear_counters(VME_REGION* restrict v210_region) {
+  if (v210_region == NULL) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL) return -1;
+  v210_wear_close(region_data->wear);
+  region_data->wear = NULL;
+  return 0;
+}
+
+int v210_flush_wear_counters(VME_REGION* restrict v210_region) {
+  if (v210_region == NULL) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL) return -1;
+  return v210_wear_flush(region_data->wear);
+}
+
+int v210_get_relay_actuations(VME_REGION* restrict v210_region, uint8_t channel, 
+    uint64_t* restrict count) {
+  if (v210_region == NULL) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL) return -1;
+  return v210_wear_get_count(region_data->wear, channel, count);
+}
+
+/***************************************************************************************************
+ * V210 Relay State Journal
+ **************************************************************************************************/
+
+int v210_attach_journal(VME_REGION* restrict v210_region, const char* restrict path) {
+  if (v210_region == NULL || path == NULL) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL || region_data->journal != NULL) return -1;
+  region_data->journal = v210_journal_open(path, (uint32_t)v210_region->vme_addr);
+  return (region_data->journal == NULL) ? -1 : 0;
+}
+
+int v210_detach_journal(VME_REGION* restrict v210_region) {
+  if (v210_region == NULL) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL) return -1;
+  v210_journal_close(region_data->journal);
+  region_data->journal = NULL;
+  return 0;
+}
+
+int v210_recover_relays(VME_REGION* restrict v210_region, v210_recovery_t* restrict recovery) {
+  if (v210_region == NULL || recovery == NULL) return -1;
+  v210_region_data_t* region_data = v210_get_region_data(v210_region);
+  if (region_data == NULL) return -1;
+  v210_journal_state_t state;
+  if (v210_journal_read(region_data->journal, &state) < 0) return -1;
+
+  memset(recovery, 0, sizeof(*recovery));
+  if (v210_sync_relay_shadow(v210_region) < 0) return -1;
+  recovery->hardware_mask = v210_words_to_mask(region_data->ctl);
+  if (v210_get_contacts(v210_region, &recovery->contact_mask) < 0) return -1;
+  recovery->interrupted = state.interrupted;
+
+  /** With an empty journal the hardware is the only record of what was commanded. */
+  recovery->commanded_mask = state.has_state ? state.commanded_mask : recovery->hardware_mask;
+  /** Relays the reconciling write changes are expected to disagree until they settle. */
+  recovery->mismatch_mask = (recovery->contact_mask ^ recovery->commanded_mask)
+      & ~(recovery->hardware_mask ^ recovery->commanded_mask);
+
+  uint16_t words[V210_CTL_REGISTER_COUNT];
+  v210_mask_to_words(recovery->commanded_mask, words);
+  for (int8_t i = 0; i < V210_CTL_REGISTER_COUNT; i++) {
+    if (words[i] != region_data->ctl[i]) recovery->words_written++;
+  }
+  if (recovery->words_written == 0 && !state.interrupted) return 0;
+  return v210_write_relay_words(v210_region, words, false);
+}
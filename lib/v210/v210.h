@@ -18,10 +18,38 @@
 
 #define V210_CHANNEL_COUNT 64
 
+/** Number of ctl[] register words holding the relay states. */
+#define V210_RELAY_WORD_COUNT 4
+
 /***************************************************************************************************
  * TYPES
  **************************************************************************************************/
 
+/** V210 Relay Transition Policy. */
+typedef enum v210_switch_policy_t {
+  V210_SWITCH_BREAK_BEFORE_MAKE,  /** Open relays leaving the path before closing new ones. */
+  V210_SWITCH_MAKE_BEFORE_BREAK,  /** Close relays joining the path before opening old ones. */
+} v210_switch_policy_t;
+
+/** V210 Relay State Recovery Results. */
+typedef struct v210_recovery_t {
+  bool interrupted;         /** True if a relay write was in progress when the process died. */
+  uint64_t commanded_mask;  /** Relay states restored: the last commanded mask in the journal. */
+  uint64_t hardware_mask;   /** Relay states read from ctl[] before reconciling. */
+  uint64_t contact_mask;    /** Contact states read from rcon[] before reconciling. */
+  uint64_t mismatch_mask;   /** Relays left as commanded whose contacts disagree with ctl[]. */
+  uint8_t words_written;    /** Number of ctl[] words written to reconcile. */
+} v210_recovery_t;
+
+/** V210 Relay Settle Time Statistics. */
+typedef struct v210_settle_stats_t {
+  uint32_t count;           /** Number of recorded settles. */
+  uint64_t min_ns;          /** Shortest settle time. */
+  uint64_t max_ns;          /** Longest settle time. */
+  uint64_t total_ns;        /** Sum of all settle times (divide by count for the mean). */
+  uint64_t last_change_ns;  /** Time of the last write that changed the relay (CLOCK_MONOTONIC). */
+} v210_settle_stats_t;
+
 /***************************************************************************************************
  * VARIABLES
  **************************************************************************************************/
@@ -46,6 +74,33 @@ VME_REGION* v210_add_region(
   const char* restrict name
 );
 
+/**
+ * Gets the size of the storage that v210_add_region_at() needs for one region.
+ *
+ * @return Size in bytes, a multiple of the cache line size.
+ */
+size_t v210_get_region_storage_size(void);
+
+/**
+ * Adds a VME region for the V210 module in caller-provided storage instead of allocating it. The
+ * storage must stay valid until the region is released with v210_release_region(). No settle
+ * statistics are kept until storage for them is attached with v210_attach_settle_stats().
+ *
+ * @param  hV120     Handle to the V120 library.
+ * @param  vme_addr  Base address of the V210 module.
+ * @param  addr_mode Addressing mode (A16, A24).
+ * @param  name      Name of the VME region.
+ * @param  storage   Cache-line aligned storage of v210_get_region_storage_size() bytes.
+ * @return Pointer to the VME region (at the start of storage), or NULL on failure.
+ */
+VME_REGION* v210_add_region_at(
+  V120_HANDLE* restrict hV120,
+  const uint32_t vme_addr,
+  const V120_PD addr_mode,
+  const char* restrict name,
+  void* restrict storage
+);
+
 /**
  * Prints the information of the VME region for the V210 module.
  * 
@@ -61,6 +116,21 @@ int v210_print_region_info(VME_REGION* v210_region);
  */
 void v210_delete_region(VME_REGION* restrict v210_region);
 
+/**
+ * Releases the resources (wear counters, journal) of a VME region added with v210_add_region_at()
+ * without freeing its storage.
+ *
+ * @param  v210_region VME region of the V210 module.
+ */
+void v210_release_region(VME_REGION* restrict v210_region);
+
+/**
+ * Gets the current CLOCK_MONOTONIC time, the time base of every timestamp in the V210 library.
+ * 
+ * @return Current time in nanoseconds.
+ */
+uint64_t v210_get_time_ns(void);
+
 /***************************************************************************************************
  * V210 Overhead Information
  **************************************************************************************************/
@@ -150,6 +220,27 @@ int v210_enable_relay_drivers(VME_REGION* restrict v210_region);
  */
 int v210_disable_relay_drivers(VME_REGION* restrict v210_region);
 
+/**
+ * Sets the error LED and the P4TM and P3TM relay drivers on the V210 module with a single csr
+ * write.
+ * 
+ * @param  v210_region           VME region of the V210 module.
+ * @param  error_led_on          True to turn the error LED on, false to turn it off.
+ * @param  relay_drivers_enabled True to enable the relay drivers, false to disable them.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_set_csr(VME_REGION* restrict v210_region, bool error_led_on, bool relay_drivers_enabled);
+
+/**
+ * Reloads the csr shadow from the V210 module. Only needed if csr was changed outside of this
+ * library; the shadow is otherwise loaded on first use. LED and relay driver updates are single
+ * csr writes based on the shadow, serialized per region.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_sync_csr_shadow(VME_REGION* restrict v210_region);
+
 /**
  * Checks if the P4TM relay driver on the V210 module is enabled.
  * 
@@ -174,6 +265,7 @@ int v210_is_p3tm_driver_enabled(VME_REGION* restrict v210_region, bool* is_enabl
 
 /**
  * Sets multiple channel relays on the V210 module based on the provided channel mask.
+ * All four ctl[] registers are written and the relay shadow is refreshed.
  * 
  * @param  v210_region VME region of the V210 module.
  * @param  channel_mask 64-bit mask where each bit represents a channel (0 - 63).
@@ -183,6 +275,7 @@ int v210_set_relays(VME_REGION* restrict v210_region, uint64_t channel_mask);
 
 /**
  * Gets the status of all channel relays on the V210 module as a 64-bit mask.
+ * The relay shadow is refreshed from the values read.
  * 
  * @param  v210_region       VME region of the V210 module.
  * @param  let_relays_settle If true, waits for 10 ms to allow relays to settle before reading.
@@ -190,3 +283,278 @@ int v210_set_relays(VME_REGION* restrict v210_region, uint64_t channel_mask);
  * @return 0 on success, non-zero on failure.
  */
 int v210_get_relays(VME_REGION* restrict v210_region, bool let_relays_settle, uint64_t* mask);
+
+/***************************************************************************************************
+ * V210 Shadowed Relay Control
+ **************************************************************************************************/
+
+/**
+ * Reloads the relay shadow from the ctl[] registers of the V210 module. Only needed if the relays
+ * were changed outside of this library; the shadow is otherwise loaded on first use.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_sync_relay_shadow(VME_REGION* restrict v210_region);
+
+/**
+ * Gets the last commanded relay states from the relay shadow without a bus read.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  mask        Storage for the 64-bit mask of commanded relay states.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_get_commanded_relays(VME_REGION* restrict v210_region, uint64_t* restrict mask);
+
+/**
+ * Sets all channel relays to the provided mask, writing only the ctl[] registers that differ
+ * from the relay shadow.
+ * 
+ * @param  v210_region  VME region of the V210 module.
+ * @param  channel_mask 64-bit mask where each bit represents a channel (0 - 63).
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_update_relays(VME_REGION* restrict v210_region, uint64_t channel_mask);
+
+/**
+ * Writes a single ctl[] register word if it differs from the relay shadow. ctl[3] holds
+ * channels 0 - 15 and ctl[0] holds channels 48 - 63.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  word        ctl[] register index (0 - 3).
+ * @param  value       16-bit relay states for the register.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_write_relay_word(VME_REGION* restrict v210_region, uint8_t word, uint16_t value);
+
+/**
+ * Sets the relays in the provided mask, leaving all other relays unchanged.
+ * 
+ * @param  v210_region  VME region of the V210 module.
+ * @param  channel_mask 64-bit mask of the relays to set.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_set_relay_mask(VME_REGION* restrict v210_region, uint64_t channel_mask);
+
+/**
+ * Clears the relays in the provided mask, leaving all other relays unchanged.
+ * 
+ * @param  v210_region  VME region of the V210 module.
+ * @param  channel_mask 64-bit mask of the relays to clear.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_clear_relay_mask(VME_REGION* restrict v210_region, uint64_t channel_mask);
+
+/**
+ * Toggles the relays in the provided mask, leaving all other relays unchanged.
+ * 
+ * @param  v210_region  VME region of the V210 module.
+ * @param  channel_mask 64-bit mask of the relays to toggle.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_toggle_relay_mask(VME_REGION* restrict v210_region, uint64_t channel_mask);
+
+/**
+ * Sets a single channel relay. Costs one register write once the shadow is loaded.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  channel     Channel number (0 - 63).
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_set_relay(VME_REGION* restrict v210_region, uint8_t channel);
+
+/**
+ * Clears a single channel relay. Costs one register write once the shadow is loaded.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  channel     Channel number (0 - 63).
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_clear_relay(VME_REGION* restrict v210_region, uint8_t channel);
+
+/**
+ * Toggles a single channel relay. Costs one register write once the shadow is loaded.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  channel     Channel number (0 - 63).
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_toggle_relay(VME_REGION* restrict v210_region, uint8_t channel);
+
+/***************************************************************************************************
+ * V210 Relay Contact Verification
+ **************************************************************************************************/
+
+/**
+ * Gets the sensed relay contact states (rcon[]) of all channels as a 64-bit mask.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  mask        Storage for the 64-bit mask representing the contact states.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_get_contacts(VME_REGION* restrict v210_region, uint64_t* restrict mask);
+
+/**
+ * Polls the relay contacts (rcon[]) until they match the commanded relay states or the timeout
+ * expires. The settle time of each relay changed since the last verification, measured from the
+ * last write that changed that relay, is recorded in the per-relay settle statistics, if attached.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  timeout_us  Maximum time to wait, in microseconds.
+ * @param  settle_ns   Optional storage for the time between the last relay change and the
+ *                     contacts matching (or the elapsed time on timeout).
+ * @return 0 on success, -1 on failure, -2 if the contacts did not match before the timeout.
+ */
+int v210_verify_relays(
+  VME_REGION* restrict v210_region, 
+  uint32_t timeout_us, 
+  uint64_t* restrict settle_ns
+);
+
+/**
+ * Attaches storage for the settle time statistics of all relays, kept out of line so that the
+ * per-region data stays small. v210_add_region() attaches storage of its own; regions added with
+ * v210_add_region_at() keep no statistics until storage is attached.
+ *
+ * @param  v210_region VME region of the V210 module.
+ * @param  stats       Storage for V210_CHANNEL_COUNT statistics, cleared by the call. Must stay
+ *                     valid until the region is released.
+ * @return 0 on success, non-zero on failure (including if storage is already attached).
+ */
+int v210_attach_settle_stats(
+  VME_REGION* restrict v210_region,
+  v210_settle_stats_t* restrict stats
+);
+
+/**
+ * Gets the settle time statistics of a single relay.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  channel     Channel number (0 - 63).
+ * @param  stats       Storage for the settle time statistics.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_get_settle_stats(
+  VME_REGION* restrict v210_region, 
+  uint8_t channel, 
+  v210_settle_stats_t* restrict stats
+);
+
+/**
+ * Resets the settle time statistics of all relays. The change times of relays still awaiting
+ * verification are kept.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_reset_settle_stats(VME_REGION* restrict v210_region);
+
+/***************************************************************************************************
+ * V210 Relay Transitions
+ **************************************************************************************************/
+
+/**
+ * Moves the relays from one state to another in two ordered phases according to the policy.
+ * Break-before-make first opens the relays set in old_mask but not in new_mask; make-before-break
+ * first closes the relays set in new_mask but not in old_mask. Each phase writes only the ctl[]
+ * words that change. The relays are allowed to settle between phases only when both phases
+ * change something, either by waiting the fixed 10 ms settling time or, if verify_timeout_us is
+ * non-zero, by verifying the contacts against rcon[].
+ * 
+ * @param  v210_region       VME region of the V210 module.
+ * @param  old_mask          Current relay states (normally the commanded relay states).
+ * @param  new_mask          Target relay states.
+ * @param  policy            Transition policy.
+ * @param  verify_timeout_us If non-zero, the maximum time to wait for the first phase to verify.
+ * @return 0 on success, -1 on failure, -2 if the first phase did not verify before the timeout
+ *         (the second phase is not written).
+ */
+int v210_switch_relays(
+  VME_REGION* restrict v210_region, 
+  uint64_t old_mask, 
+  uint64_t new_mask, 
+  v210_switch_policy_t policy, 
+  uint32_t verify_timeout_us
+);
+
+/***************************************************************************************************
+ * V210 Relay Wear Counters
+ **************************************************************************************************/
+
+/**
+ * Attaches persistent relay actuation counters to the V210 module. Every relay write through this
+ * library then counts one actuation per relay that changed state. The counters are stored in a
+ * memory-mapped file in the given directory, keyed by board ID and VME address, and are detached
+ * automatically when the region is deleted.
+ * 
+ * @param  v210_region VME region of the V210 module (must already be allocated).
+ * @param  directory   Directory holding the counter files.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_attach_wear_counters(VME_REGION* restrict v210_region, const char* restrict directory);
+
+/**
+ * Flushes and detaches the relay actuation counters of the V210 module.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_detach_wear_counters(VME_REGION* restrict v210_region);
+
+/**
+ * Schedules write-back of the relay actuation counters without waiting for it.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_flush_wear_counters(VME_REGION* restrict v210_region);
+
+/**
+ * Gets the actuation count of a single relay.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  channel     Channel number (0 - 63).
+ * @param  count       Storage for the actuation count.
+ * @return 0 on success, non-zero on failure (including if no counters are attached).
+ */
+int v210_get_relay_actuations(
+  VME_REGION* restrict v210_region, 
+  uint8_t channel, 
+  uint64_t* restrict count
+);
+
+/***************************************************************************************************
+ * V210 Relay State Journal
+ **************************************************************************************************/
+
+/**
+ * Attaches a crash-safe relay state journal to the V210 module. Every relay write through this
+ * library then records the commanded mask and a sequence number in the journal before and after
+ * the write. The journal is detached automatically when the region is deleted.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @param  path        Path of the journal file (one per module).
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_attach_journal(VME_REGION* restrict v210_region, const char* restrict path);
+
+/**
+ * Flushes and detaches the relay state journal of the V210 module.
+ * 
+ * @param  v210_region VME region of the V210 module.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_detach_journal(VME_REGION* restrict v210_region);
+
+/**
+ * Restores the last commanded relay states after a restart. Reads the journal together with the
+ * hardware ctl[] and rcon[] registers, loads the relay shadow from ctl[], and writes only the
+ * ctl[] words that differ from the journaled mask. If the journal is empty, the hardware state is
+ * kept as is. Relays already in their commanded state whose contacts disagree with it (welded,
+ * stuck or still settling) are not rewritten but are reported in the mismatch mask.
+ * 
+ * @param  v210_region VME region of the V210 module (must have a journal attached).
+ * @param  recovery    Storage for the recovery results.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_recover_relays(VME_REGION* restrict v210_region, v210_recovery_t* restrict recovery);
@@ -0,0 +1,229 @@
+/**
+ * Implementation of the V210 Relay State History.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "v210.h"
+#include "v210_history.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define V210_HISTORY_MIN_CAPACITY V210_HISTORY_CHECKPOINT_INTERVAL
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V210 Relay State History. */
+struct v210_history_t {
+  v210_history_entry_t* entries;
+  size_t count;
+  size_t capacity;
+  /** checkpoints[k] holds the full state after entries[k * V210_HISTORY_CHECKPOINT_INTERVAL]. */
+  uint64_t* checkpoints;
+  uint64_t last_state;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+/**
+ * Computes the number of checkpoints needed to index the given number of entries.
+ *
+ * @param  capacity Number of entries.
+ * @return Number of checkpoints.
+ */
+static inline size_t v210_history_checkpoint_count(size_t capacity) {
+  return (capacity + V210_HISTORY_CHECKPOINT_INTERVAL - 1) / V210_HISTORY_CHECKPOINT_INTERVAL;
+}
+
+/**
+ * Resizes the entry and checkpoint storage of the history.
+ *
+ * @param  history  History to resize.
+ * @param  capacity New entry capacity.
+ * @return 0 on success, -1 on failure.
+ */
+static int v210_history_reserve(v210_history_t* restrict history, size_t capacity) {
+  v210_history_entry_t* entries = realloc(history->entries, capacity * sizeof(*entries));
+  if (entries == NULL) return -1;
+  history->entries = entries;
+
+  uint64_t* checkpoints = realloc(history->checkpoints,
+      v210_history_checkpoint_count(capacity) * sizeof(*checkpoints));
+  if (checkpoints == NULL) return -1;
+  history->checkpoints = checkpoints;
+
+  history->capacity = capacity;
+  return 0;
+}
+
+v210_history_t* v210_history_create(size_t initial_capacity) {
+  v210_history_t* history = malloc(sizeof(v210_history_t));
+  if (history == NULL) {
+    printf("v210_history_create: Failed to allocate memory for history\n");
+    return NULL;
+  }
+  memset(history, 0, sizeof(v210_history_t));
+
+  if (initial_capacity < V210_HISTORY_MIN_CAPACITY) initial_capacity = V210_HISTORY_MIN_CAPACITY;
+  if (v210_history_reserve(history, initial_capacity) < 0) {
+    printf("v210_history_create: Failed to allocate memory for history entries\n");
+    v210_history_delete(history);
+    return NULL;
+  }
+
+  return history;
+}
+
+void v210_history_delete(v210_history_t* restrict history) {
+  if (history == NULL) return;
+  free(history->entries);
+  free(history->checkpoints);
+  free(history);
+}
+
+int v210_history_record(v210_history_t* restrict history, uint64_t timestamp_ns, uint64_t mask) {
+  if (history == NULL) return -1;
+
+  if (history->count > 0) {
+    v210_history_entry_t* last = &history->entries[history->count - 1];
+    if (timestamp_ns < last->timestamp_ns) return -1;
+    if (mask == history->last_state) {
+      if (last->run_length < UINT32_MAX) last->run_length++;
+      return 0;
+    }
+  }
+
+  if (history->count == history->capacity) {
+    if (v210_history_reserve(history, history->capacity * 2) < 0) {
+      printf("v210_history_record: Failed to grow history\n");
+      return -1;
+    }
+  }
+
+  size_t index = history->count++;
+  history->entries[index].timestamp_ns = timestamp_ns;
+  history->entries[index].delta = mask ^ history->last_state;
+  history->entries[index].run_length = 1;
+  if ((index % V210_HISTORY_CHECKPOINT_INTERVAL) == 0) {
+    history->checkpoints[index / V210_HISTORY_CHECKPOINT_INTERVAL] = mask;
+  }
+  history->last_state = mask;
+  return 0;
+}
+
+int v210_history_poll(v210_history_t* restrict history, VME_REGION* restrict v210_region) {
+  if (history == NULL || v210_region == NULL) return -1;
+  uint64_t mask;
+  if (v210_get_relays(v210_region, false, &mask) < 0) return -1;
+  return v210_history_record(history, v210_get_time_ns(), mask);
+}
+
+int v210_history_get_entry_count(const v210_history_t* restrict history, size_t* restrict count) {
+  if (history == NULL) return -1;
+  *count = history->count;
+  return 0;
+}
+
+int v210_history_get_entry(const v210_history_t* restrict history, size_t index,
+    v210_history_entry_t* restrict entry) {
+  if (history == NULL || index >= history->count) return -1;
+  *entry = history->entries[index];
+  return 0;
+}
+
+/**
+ * Finds the index of the first entry with a timestamp greater than or equal to the given time.
+ *
+ * @param  history      History to search.
+ * @param  timestamp_ns Time to search for.
+ * @return Index of the entry, or history->count if there is none.
+ */
+static size_t v210_history_lower_bound(const v210_history_t* restrict history,
+    uint64_t timestamp_ns) {
+  size_t low = 0, high = history->count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (history->entries[mid].timestamp_ns < timestamp_ns) low = mid + 1;
+    else high = mid;
+  }
+  return low;
+}
+
+/**
+ * Finds the index of the first entry with a timestamp greater than the given time.
+ *
+ * @param  history      History to search.
+ * @param  timestamp_ns Time to search for.
+ * @return Index of the entry, or history->count if there is none.
+ */
+static size_t v210_history_upper_bound(const v210_history_t* restrict history,
+    uint64_t timestamp_ns) {
+  size_t low = 0, high = history->count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (history->entries[mid].timestamp_ns <= timestamp_ns) low = mid + 1;
+    else high = mid;
+  }
+  return low;
+}
+
+int v210_history_get_state(const v210_history_t* restrict history, uint64_t timestamp_ns,
+    uint64_t* restrict mask) {
+  if (history == NULL) return -1;
+
+  /** The state at time T is the state after the last entry at or before T. */
+  size_t end = v210_history_upper_bound(history, timestamp_ns);
+  if (end == 0) return -2;
+  size_t index = end - 1;
+
+  size_t checkpoint = index / V210_HISTORY_CHECKPOINT_INTERVAL;
+  uint64_t state = history->checkpoints[checkpoint];
+  for (size_t i = checkpoint * V210_HISTORY_CHECKPOINT_INTERVAL + 1; i <= index; i++) {
+    state ^= history->entries[i].delta;
+  }
+  *mask = state;
+  return 0;
+}
+
+int v210_history_get_relay(const v210_history_t* restrict history, uint8_t channel,
+    uint64_t timestamp_ns, bool* restrict is_set) {
+  if (channel >= V210_CHANNEL_COUNT) return -1;
+  uint64_t mask;
+  int status = v210_history_get_state(history, timestamp_ns, &mask);
+  if (status != 0) return status;
+  *is_set = ((mask >> channel) & 0x1) != 0;
+  return 0;
+}
+
+int v210_history_get_changes(const v210_history_t* restrict history, uint64_t start_ns,
+    uint64_t end_ns, size_t* restrict first, size_t* restrict count) {
+  if (history == NULL || end_ns < start_ns) return -1;
+  size_t start = v210_history_lower_bound(history, start_ns);
+  size_t end = v210_history_lower_bound(history, end_ns);
+  *first = start;
+  *count = end - start;
+  return 0;
+}
+
+int v210_history_clear(v210_history_t* restrict history) {
+  if (history == NULL) return -1;
+  history->count = 0;
+  history->last_state = 0;
+  return 0;
+}
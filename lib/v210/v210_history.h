@@ -0,0 +1,164 @@
+/**
+ * Public API for recording a timestamped history of V210 relay states.
+ *
+ * The history stores one entry per change of the 64-bit relay mask rather than one per poll. Each
+ * entry holds the XOR delta from the previous state and the number of polls the new state was
+ * seen for. Full masks are checkpointed every V210_HISTORY_CHECKPOINT_INTERVAL entries so that any
+ * point in time can be reconstructed in logarithmic time.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Number of entries between full-mask checkpoints in the sparse index. */
+#define V210_HISTORY_CHECKPOINT_INTERVAL 64
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V210 History Entry. */
+typedef struct v210_history_entry_t {
+  uint64_t timestamp_ns;  /** Time the new state was first seen (CLOCK_MONOTONIC). */
+  uint64_t delta;         /** XOR of the new state with the previous state. */
+  uint32_t run_length;    /** Number of polls the new state was seen for. */
+} v210_history_entry_t;
+
+/** V210 Relay State History (opaque). */
+typedef struct v210_history_t v210_history_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates an empty relay state history.
+ *
+ * @param  initial_capacity Number of entries to preallocate (grown on demand).
+ * @return Pointer to the history, or NULL on failure.
+ */
+v210_history_t* v210_history_create(size_t initial_capacity);
+
+/**
+ * Deletes a relay state history.
+ *
+ * @param  history History to delete.
+ */
+void v210_history_delete(v210_history_t* restrict history);
+
+/**
+ * Records a relay state sample. A new entry is only added if the state differs from the last
+ * recorded state; otherwise the run length of the last entry is incremented.
+ *
+ * @param  history      History to record into.
+ * @param  timestamp_ns Time of the sample in nanoseconds. Must not be earlier than the last sample.
+ * @param  mask         64-bit relay mask.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_history_record(v210_history_t* restrict history, uint64_t timestamp_ns, uint64_t mask);
+
+/**
+ * Reads the relay states of the V210 module and records them with the current CLOCK_MONOTONIC time.
+ *
+ * @param  history     History to record into.
+ * @param  v210_region VME region of the V210 module.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_history_poll(v210_history_t* restrict history, VME_REGION* restrict v210_region);
+
+/**
+ * Gets the number of recorded entries (state changes, including the first sample).
+ *
+ * @param  history History to query.
+ * @param  count   Storage for the number of entries.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_history_get_entry_count(const v210_history_t* restrict history, size_t* restrict count);
+
+/**
+ * Gets a recorded entry by index.
+ *
+ * @param  history History to query.
+ * @param  index   Entry index (0 to count - 1).
+ * @param  entry   Storage for the entry.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_history_get_entry(
+  const v210_history_t* restrict history,
+  size_t index,
+  v210_history_entry_t* restrict entry
+);
+
+/**
+ * Gets the relay state mask at the given time.
+ *
+ * @param  history      History to query.
+ * @param  timestamp_ns Time to query.
+ * @param  mask         Storage for the 64-bit relay mask.
+ * @return 0 on success, -1 on failure, -2 if the time is before the first recorded sample.
+ */
+int v210_history_get_state(
+  const v210_history_t* restrict history,
+  uint64_t timestamp_ns,
+  uint64_t* restrict mask
+);
+
+/**
+ * Gets the state of a single relay at the given time.
+ *
+ * @param  history      History to query.
+ * @param  channel      Relay channel (0 - 63).
+ * @param  timestamp_ns Time to query.
+ * @param  is_set       Storage for the relay state.
+ * @return 0 on success, -1 on failure, -2 if the time is before the first recorded sample.
+ */
+int v210_history_get_relay(
+  const v210_history_t* restrict history,
+  uint8_t channel,
+  uint64_t timestamp_ns,
+  bool* restrict is_set
+);
+
+/**
+ * Gets the range of entries whose changes occurred within [start_ns, end_ns). Entries are then
+ * read with v210_history_get_entry(). The first recorded sample counts as a change.
+ *
+ * @param  history  History to query.
+ * @param  start_ns Start of the window (inclusive).
+ * @param  end_ns   End of the window (exclusive).
+ * @param  first    Storage for the index of the first entry in the window.
+ * @param  count    Storage for the number of entries in the window.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_history_get_changes(
+  const v210_history_t* restrict history,
+  uint64_t start_ns,
+  uint64_t end_ns,
+  size_t* restrict first,
+  size_t* restrict count
+);
+
+/**
+ * Clears all recorded entries while keeping the allocated storage.
+ *
+ * @param  history History to clear.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_history_clear(v210_history_t* restrict history);
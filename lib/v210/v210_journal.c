@@ -0,0 +1,143 @@
+/**
+ * Implementation of the V210 Relay State Journal.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "v210_journal.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Journal file magic ("V21J"). */
+#define V210_JOURNAL_MAGIC 0x4A313256
+
+#define V210_JOURNAL_VERSION 1
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Layout of the journal file. */
+typedef struct v210_journal_file_t {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t vme_addr;
+  uint32_t reserved2;
+  /** Incremented before each write; pending_mask is valid from then on. */
+  _Atomic uint64_t begin_seq;
+  /** Set to begin_seq after each write; committed_mask is valid from then on. */
+  _Atomic uint64_t end_seq;
+  uint64_t pending_mask;
+  uint64_t committed_mask;
+} v210_journal_file_t;
+
+/** V210 Relay State Journal. */
+struct v210_journal_t {
+  v210_journal_file_t* file;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+v210_journal_t* v210_journal_open(const char* restrict path, uint32_t vme_addr) {
+  if (path == NULL) return NULL;
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    printf("v210_journal_open: Failed to open %s\n", path);
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 ||
+      ((size_t)st.st_size < sizeof(v210_journal_file_t) &&
+       ftruncate(fd, sizeof(v210_journal_file_t)) < 0)) {
+    printf("v210_journal_open: Failed to size %s\n", path);
+    close(fd);
+    return NULL;
+  }
+
+  v210_journal_file_t* file = mmap(NULL, sizeof(v210_journal_file_t), PROT_READ | PROT_WRITE,
+      MAP_SHARED, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    printf("v210_journal_open: Failed to map %s\n", path);
+    return NULL;
+  }
+
+  if (file->magic != V210_JOURNAL_MAGIC || file->version != V210_JOURNAL_VERSION) {
+    memset(file, 0, sizeof(v210_journal_file_t));
+    file->version = V210_JOURNAL_VERSION;
+    file->vme_addr = vme_addr;
+    file->magic = V210_JOURNAL_MAGIC;
+  } else if (file->vme_addr != vme_addr) {
+    printf("v210_journal_open: %s belongs to VME address 0x%08X\n", path, file->vme_addr);
+    munmap(file, sizeof(v210_journal_file_t));
+    return NULL;
+  }
+
+  v210_journal_t* journal = malloc(sizeof(v210_journal_t));
+  if (journal == NULL) {
+    printf("v210_journal_open: Failed to allocate memory for journal\n");
+    munmap(file, sizeof(v210_journal_file_t));
+    return NULL;
+  }
+  journal->file = file;
+  return journal;
+}
+
+void v210_journal_close(v210_journal_t* restrict journal) {
+  if (journal == NULL) return;
+  msync(journal->file, sizeof(v210_journal_file_t), MS_SYNC);
+  munmap(journal->file, sizeof(v210_journal_file_t));
+  free(journal);
+}
+
+void v210_journal_begin(v210_journal_t* restrict journal, uint64_t mask) {
+  if (journal == NULL) return;
+  v210_journal_file_t* file = journal->file;
+  file->pending_mask = mask;
+  uint64_t seq = atomic_load_explicit(&file->begin_seq, memory_order_relaxed);
+  atomic_store_explicit(&file->begin_seq, seq + 1, memory_order_release);
+}
+
+void v210_journal_commit(v210_journal_t* restrict journal) {
+  if (journal == NULL) return;
+  v210_journal_file_t* file = journal->file;
+  file->committed_mask = file->pending_mask;
+  uint64_t seq = atomic_load_explicit(&file->begin_seq, memory_order_relaxed);
+  atomic_store_explicit(&file->end_seq, seq, memory_order_release);
+}
+
+int v210_journal_read(const v210_journal_t* restrict journal,
+    v210_journal_state_t* restrict state) {
+  if (journal == NULL) return -1;
+  v210_journal_file_t* file = journal->file;
+  uint64_t begin_seq = atomic_load_explicit(&file->begin_seq, memory_order_acquire);
+  uint64_t end_seq = atomic_load_explicit(&file->end_seq, memory_order_acquire);
+  state->has_state = begin_seq != 0;
+  state->interrupted = begin_seq != end_seq;
+  state->sequence = begin_seq;
+  state->commanded_mask = file->pending_mask;
+  state->committed_mask = file->committed_mask;
+  return 0;
+}
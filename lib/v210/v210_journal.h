@@ -0,0 +1,85 @@
+/**
+ * Public API for the crash-safe V210 relay state journal.
+ *
+ * The journal is a small memory-mapped file recording the relay mask being written and the last
+ * mask completely written, each guarded by a sequence number. The updates are plain memory stores,
+ * and the kernel keeps them in the page cache if the process dies, so after a restart the journal
+ * shows which relays were commanded and whether a write was interrupted.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V210 Relay State Journal (opaque). */
+typedef struct v210_journal_t v210_journal_t;
+
+/** V210 Relay State Journal Contents. */
+typedef struct v210_journal_state_t {
+  bool has_state;           /** False if nothing has been journaled yet. */
+  bool interrupted;         /** True if the last write began but did not complete. */
+  uint64_t sequence;        /** Sequence number of the last write that began. */
+  uint64_t commanded_mask;  /** Mask of the last write that began. */
+  uint64_t committed_mask;  /** Mask of the last write that completed. */
+} v210_journal_state_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Opens (creating if needed) a relay state journal file and maps it into memory.
+ *
+ * @param  path     Path of the journal file.
+ * @param  vme_addr VME base address of the V210 module, checked against an existing journal.
+ * @return Pointer to the journal, or NULL on failure.
+ */
+v210_journal_t* v210_journal_open(const char* restrict path, uint32_t vme_addr);
+
+/**
+ * Flushes and unmaps the relay state journal.
+ *
+ * @param  journal Journal to close.
+ */
+void v210_journal_close(v210_journal_t* restrict journal);
+
+/**
+ * Records that a write of the given mask is about to begin.
+ *
+ * @param  journal Journal.
+ * @param  mask    64-bit relay mask about to be written.
+ */
+void v210_journal_begin(v210_journal_t* restrict journal, uint64_t mask);
+
+/**
+ * Records that the write started by the last v210_journal_begin() has completed.
+ *
+ * @param  journal Journal.
+ */
+void v210_journal_commit(v210_journal_t* restrict journal);
+
+/**
+ * Reads the journal contents.
+ *
+ * @param  journal Journal.
+ * @param  state   Storage for the journal contents.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_journal_read(const v210_journal_t* restrict journal, v210_journal_state_t* restrict state);
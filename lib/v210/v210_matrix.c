@@ -0,0 +1,188 @@
+/**
+ * Implementation of the V210 Relay Matrix.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "v210.h"
+#include "v210_matrix.h"
+#include "v210_reg.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define V210_MATRIX_RCON_WORDS 4
+
+/** Interval between batched rcon[] readbacks while verifying the matrix. */
+#define V210_MATRIX_VERIFY_POLL_INTERVAL_NS 100000L
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V210 Relay Matrix. */
+struct v210_matrix_t {
+  V120_HANDLE* hV120;
+  VME_REGION** regions;
+  size_t board_count;
+  /** Chained DMA descriptors reading rcon[] of every board into rcon. */
+  struct v120_dma_desc_t* rcon_desc;
+  uint16_t (*rcon)[V210_MATRIX_RCON_WORDS];
+  /** Scratch masks for verification: expected states, then contact states. */
+  uint64_t* verify_masks;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+/**
+ * Gets the DMA address space flags matching the addressing mode of a VME region.
+ *
+ * @param  region VME region.
+ * @return DMA address space flags.
+ */
+static inline uint32_t v210_matrix_dma_space(const VME_REGION* restrict region) {
+  return ((region->config & V120_A24) == V120_A24) ? V120_PD_A24 : V120_PD_A16;
+}
+
+v210_matrix_t* v210_matrix_create(V120_HANDLE* restrict hV120, VME_REGION* const* restrict regions,
+    size_t board_count) {
+  if (regions == NULL || board_count == 0) return NULL;
+
+  v210_matrix_t* matrix = malloc(sizeof(v210_matrix_t));
+  if (matrix == NULL) {
+    printf("v210_matrix_create: Failed to allocate memory for matrix\n");
+    return NULL;
+  }
+  memset(matrix, 0, sizeof(v210_matrix_t));
+
+  matrix->hV120 = hV120;
+  matrix->board_count = board_count;
+  matrix->regions = malloc(board_count * sizeof(*matrix->regions));
+  matrix->rcon_desc = malloc(board_count * sizeof(*matrix->rcon_desc));
+  matrix->rcon = malloc(board_count * sizeof(*matrix->rcon));
+  matrix->verify_masks = malloc(2 * board_count * sizeof(*matrix->verify_masks));
+  if (matrix->regions == NULL || matrix->rcon_desc == NULL || matrix->rcon == NULL ||
+      matrix->verify_masks == NULL) {
+    printf("v210_matrix_create: Failed to allocate memory for matrix boards\n");
+    v210_matrix_delete(matrix);
+    return NULL;
+  }
+
+  for (size_t board = 0; board < board_count; board++) {
+    if (regions[board] == NULL) {
+      printf("v210_matrix_create: Missing VME region for board %zu\n", board);
+      v210_matrix_delete(matrix);
+      return NULL;
+    }
+    matrix->regions[board] = regions[board];
+    matrix->rcon_desc[board] = (struct v120_dma_desc_t){
+      .flags = v210_matrix_dma_space(regions[board]) | V120_PD_D16 | V120_PD_ESHORT,
+      .ptr = (__u64)(uintptr_t)matrix->rcon[board],
+      .size = sizeof(matrix->rcon[board]),
+      .next = (board + 1 < board_count) ? (__u64)(uintptr_t)&matrix->rcon_desc[board + 1] : 0LL,
+      .vme_address = regions[board]->vme_addr + offsetof(v210_registers, rcon),
+    };
+  }
+
+  return matrix;
+}
+
+void v210_matrix_delete(v210_matrix_t* restrict matrix) {
+  if (matrix == NULL) return;
+  free(matrix->regions);
+  free(matrix->rcon_desc);
+  free(matrix->rcon);
+  free(matrix->verify_masks);
+  free(matrix);
+}
+
+int v210_matrix_get_board_count(const v210_matrix_t* restrict matrix,
+    size_t* restrict board_count) {
+  if (matrix == NULL) return -1;
+  *board_count = matrix->board_count;
+  return 0;
+}
+
+int v210_matrix_get_region(const v210_matrix_t* restrict matrix, size_t board,
+    VME_REGION** restrict region) {
+  if (matrix == NULL || board >= matrix->board_count) return -1;
+  *region = matrix->regions[board];
+  return 0;
+}
+
+int v210_matrix_update(v210_matrix_t* restrict matrix, const uint64_t* restrict masks) {
+  if (matrix == NULL || masks == NULL) return -1;
+  for (size_t board = 0; board < matrix->board_count; board++) {
+    if (v210_update_relays(matrix->regions[board], masks[board]) < 0) return -1;
+  }
+  return 0;
+}
+
+int v210_matrix_get_commanded(v210_matrix_t* restrict matrix, uint64_t* restrict masks) {
+  if (matrix == NULL || masks == NULL) return -1;
+  for (size_t board = 0; board < matrix->board_count; board++) {
+    if (v210_get_commanded_relays(matrix->regions[board], &masks[board]) < 0) return -1;
+  }
+  return 0;
+}
+
+int v210_matrix_set_relay(v210_matrix_t* restrict matrix, size_t relay) {
+  if (matrix == NULL || relay >= matrix->board_count * V210_CHANNEL_COUNT) return -1;
+  return v210_set_relay(matrix->regions[relay / V210_CHANNEL_COUNT],
+      (uint8_t)(relay % V210_CHANNEL_COUNT));
+}
+
+int v210_matrix_clear_relay(v210_matrix_t* restrict matrix, size_t relay) {
+  if (matrix == NULL || relay >= matrix->board_count * V210_CHANNEL_COUNT) return -1;
+  return v210_clear_relay(matrix->regions[relay / V210_CHANNEL_COUNT],
+      (uint8_t)(relay % V210_CHANNEL_COUNT));
+}
+
+int v210_matrix_get_contacts(v210_matrix_t* restrict matrix, uint64_t* restrict masks) {
+  if (matrix == NULL || masks == NULL) return -1;
+  if (v120_dma_xfr(matrix->hV120, &matrix->rcon_desc[0]) < 0) return -1;
+  for (size_t board = 0; board < matrix->board_count; board++) {
+    uint64_t mask = 0;
+    for (int8_t i = 0; i < V210_MATRIX_RCON_WORDS; i++) {
+      mask <<= 16;
+      mask |= matrix->rcon[board][i];
+    }
+    masks[board] = mask;
+  }
+  return 0;
+}
+
+int v210_matrix_verify(v210_matrix_t* restrict matrix, uint32_t timeout_us,
+    uint64_t* restrict settle_ns) {
+  if (matrix == NULL) return -1;
+
+  uint64_t* expected = matrix->verify_masks;
+  uint64_t* contacts = expected + matrix->board_count;
+  if (v210_matrix_get_commanded(matrix, expected) < 0) return -1;
+
+  const uint64_t start_ns = v210_get_time_ns();
+  const uint64_t deadline_ns = start_ns + (uint64_t)timeout_us * 1000ULL;
+  const struct timespec poll_interval = {0, V210_MATRIX_VERIFY_POLL_INTERVAL_NS};
+  for (;;) {
+    if (v210_matrix_get_contacts(matrix, contacts) < 0) return -1;
+    uint64_t now_ns = v210_get_time_ns();
+    if (settle_ns != NULL) *settle_ns = now_ns - start_ns;
+    if (memcmp(contacts, expected, matrix->board_count * sizeof(uint64_t)) == 0) return 0;
+    if (now_ns >= deadline_ns) return -2;
+    nanosleep(&poll_interval, NULL);
+  }
+}
@@ -0,0 +1,144 @@
+/**
+ * Public API for controlling many V210 modules as one logical relay matrix.
+ *
+ * Relays are numbered in a flat index space: relay i lives on board i / 64, channel i % 64. Wide
+ * relay states are passed as arrays of 64-bit masks with one mask per board, in board order.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V210 Relay Matrix (opaque). */
+typedef struct v210_matrix_t v210_matrix_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates a relay matrix over the given V210 regions. The regions remain owned by the caller and
+ * must outlive the matrix.
+ *
+ * @param  hV120       Handle to the V120 library.
+ * @param  regions     VME regions of the V210 modules, in relay index order.
+ * @param  board_count Number of V210 modules.
+ * @return Pointer to the matrix, or NULL on failure.
+ */
+v210_matrix_t* v210_matrix_create(
+  V120_HANDLE* restrict hV120,
+  VME_REGION* const* restrict regions,
+  size_t board_count
+);
+
+/**
+ * Deletes a relay matrix. The V210 regions are not deleted.
+ *
+ * @param  matrix Relay matrix to delete.
+ */
+void v210_matrix_delete(v210_matrix_t* restrict matrix);
+
+/**
+ * Gets the number of V210 modules in the matrix.
+ *
+ * @param  matrix      Relay matrix.
+ * @param  board_count Storage for the number of modules.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_matrix_get_board_count(const v210_matrix_t* restrict matrix, size_t* restrict board_count);
+
+/**
+ * Gets the VME region of a V210 module in the matrix.
+ *
+ * @param  matrix Relay matrix.
+ * @param  board  Board index.
+ * @param  region Storage for the VME region.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_matrix_get_region(
+  const v210_matrix_t* restrict matrix,
+  size_t board,
+  VME_REGION** restrict region
+);
+
+/**
+ * Sets all relays of the matrix. Per-board diffs are computed against the relay shadows and only
+ * the differing ctl[] words are written, back to back across all boards.
+ *
+ * @param  matrix Relay matrix.
+ * @param  masks  One 64-bit relay mask per board.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_matrix_update(v210_matrix_t* restrict matrix, const uint64_t* restrict masks);
+
+/**
+ * Gets the last commanded relay states of all boards without a bus read.
+ *
+ * @param  matrix Relay matrix.
+ * @param  masks  Storage for one 64-bit relay mask per board.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_matrix_get_commanded(v210_matrix_t* restrict matrix, uint64_t* restrict masks);
+
+/**
+ * Sets a single relay of the matrix.
+ *
+ * @param  matrix Relay matrix.
+ * @param  relay  Flat relay index.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_matrix_set_relay(v210_matrix_t* restrict matrix, size_t relay);
+
+/**
+ * Clears a single relay of the matrix.
+ *
+ * @param  matrix Relay matrix.
+ * @param  relay  Flat relay index.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_matrix_clear_relay(v210_matrix_t* restrict matrix, size_t relay);
+
+/**
+ * Reads the relay contacts (rcon[]) of all boards with one chained DMA transfer.
+ *
+ * @param  matrix Relay matrix.
+ * @param  masks  Storage for one 64-bit contact mask per board.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_matrix_get_contacts(v210_matrix_t* restrict matrix, uint64_t* restrict masks);
+
+/**
+ * Polls the relay contacts of all boards with batched readbacks until they match the commanded
+ * relay states or the timeout expires.
+ *
+ * @param  matrix     Relay matrix.
+ * @param  timeout_us Maximum time to wait, in microseconds.
+ * @param  settle_ns  Optional storage for the time until the contacts matched (or the elapsed time
+ *                    on timeout), measured from the call.
+ * @return 0 on success, -1 on failure, -2 if the contacts did not match before the timeout.
+ */
+int v210_matrix_verify(
+  v210_matrix_t* restrict matrix,
+  uint32_t timeout_us,
+  uint64_t* restrict settle_ns
+);
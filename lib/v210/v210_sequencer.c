@@ -0,0 +1,319 @@
+/**
+ * Implementation of the V210 Relay Sequencer.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "v210.h"
+#include "v210_sequencer.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Longest uninterrupted sleep, so a stop request is noticed between distant steps. */
+#define V210_SEQUENCER_STOP_POLL_NS 10000000ULL
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Precompiled ctl[] word write. */
+typedef struct v210_sequencer_write_t {
+  uint32_t board;
+  uint16_t value;
+  uint8_t word;
+} v210_sequencer_write_t;
+
+/** V210 Relay Sequencer. */
+struct v210_sequencer_t {
+  VME_REGION** regions;
+  size_t board_count;
+
+  size_t step_count;
+  uint64_t* offsets;
+  /**
+   * Writes of step i > 0 are writes[write_start[i]] to writes[write_start[i + 1] - 1]. Writes of
+   * step 0 are writes[0] to writes[first_write_count - 1], compiled at each start.
+   */
+  size_t* write_start;
+  v210_sequencer_write_t* writes;
+  uint64_t* first_masks;
+  size_t first_write_count;
+
+  uint64_t start_ns;
+  uint64_t* lateness;
+  atomic_size_t steps_executed;
+  atomic_bool stop_requested;
+  int status;
+  pthread_t thread;
+  bool thread_active;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+/**
+ * Appends the writes of the ctl[] words of one board that hold changed relays.
+ *
+ * @param  sequencer   Sequencer.
+ * @param  write_count Number of writes compiled so far.
+ * @param  board       Board index.
+ * @param  mask        Relay mask of the board.
+ * @param  changed     Relays that differ from the state before the step.
+ * @return New number of writes compiled.
+ */
+static size_t v210_sequencer_compile_board(v210_sequencer_t* restrict sequencer,
+    size_t write_count, size_t board, uint64_t mask, uint64_t changed) {
+  for (int8_t i = 0; i < V210_RELAY_WORD_COUNT; i++) {
+    /** ctl[3 - i] holds channels 16 * i to 16 * i + 15. */
+    if (((changed >> (16 * i)) & 0xFFFF) == 0) continue;
+    sequencer->writes[write_count++] = (v210_sequencer_write_t){
+      .board = (uint32_t)board,
+      .value = (uint16_t)((mask >> (16 * i)) & 0xFFFF),
+      .word = (uint8_t)(V210_RELAY_WORD_COUNT - 1 - i),
+    };
+  }
+  return write_count;
+}
+
+/**
+ * Compiles the first step against the relay shadow, so only words that will change are written.
+ *
+ * @param  sequencer Sequencer.
+ * @return 0 on success, -1 on failure.
+ */
+static int v210_sequencer_compile_first(v210_sequencer_t* restrict sequencer) {
+  size_t write_count = 0;
+  for (size_t board = 0; board < sequencer->board_count; board++) {
+    uint64_t commanded;
+    if (v210_get_commanded_relays(sequencer->regions[board], &commanded) < 0) return -1;
+    uint64_t mask = sequencer->first_masks[board];
+    write_count = v210_sequencer_compile_board(sequencer, write_count, board, mask,
+        mask ^ commanded);
+  }
+  sequencer->first_write_count = write_count;
+  return 0;
+}
+
+/**
+ * Compiles the steps after the first into the list of ctl[] word writes, reserving room for the
+ * writes of the first step.
+ *
+ * @param  sequencer Sequencer with regions, board count and step count set.
+ * @param  steps     Sequence steps.
+ * @return 0 on success, -1 on failure.
+ */
+static int v210_sequencer_compile(v210_sequencer_t* restrict sequencer,
+    const v210_sequence_step_t* restrict steps) {
+  const size_t words_per_step = sequencer->board_count * V210_RELAY_WORD_COUNT;
+  sequencer->writes = malloc(sequencer->step_count * words_per_step * sizeof(*sequencer->writes));
+  if (sequencer->writes == NULL) return -1;
+
+  size_t write_count = words_per_step;
+  for (size_t step = 0; step < sequencer->step_count; step++) {
+    if (steps[step].masks == NULL) return -1;
+    if (step > 0 && steps[step].offset_ns < steps[step - 1].offset_ns) return -1;
+    sequencer->offsets[step] = steps[step].offset_ns;
+    sequencer->write_start[step] = (step == 0) ? 0 : write_count;
+    if (step == 0) {
+      memcpy(sequencer->first_masks, steps[0].masks,
+          sequencer->board_count * sizeof(*sequencer->first_masks));
+      continue;
+    }
+
+    for (size_t board = 0; board < sequencer->board_count; board++) {
+      uint64_t mask = steps[step].masks[board];
+      write_count = v210_sequencer_compile_board(sequencer, write_count, board, mask,
+          mask ^ steps[step - 1].masks[board]);
+    }
+  }
+  sequencer->write_start[sequencer->step_count] = write_count;
+
+  /** Give back the space reserved for words that did not change. */
+  if (write_count > words_per_step) {
+    v210_sequencer_write_t* writes = realloc(sequencer->writes,
+        write_count * sizeof(*sequencer->writes));
+    if (writes != NULL) sequencer->writes = writes;
+  }
+  return 0;
+}
+
+v210_sequencer_t* v210_sequencer_create(v210_matrix_t* restrict matrix,
+    const v210_sequence_step_t* restrict steps, size_t step_count) {
+  if (matrix == NULL || steps == NULL || step_count == 0) return NULL;
+
+  v210_sequencer_t* sequencer = malloc(sizeof(v210_sequencer_t));
+  if (sequencer == NULL) {
+    printf("v210_sequencer_create: Failed to allocate memory for sequencer\n");
+    return NULL;
+  }
+  memset(sequencer, 0, sizeof(v210_sequencer_t));
+  atomic_init(&sequencer->steps_executed, 0);
+  atomic_init(&sequencer->stop_requested, false);
+
+  v210_matrix_get_board_count(matrix, &sequencer->board_count);
+  sequencer->step_count = step_count;
+  sequencer->regions = malloc(sequencer->board_count * sizeof(*sequencer->regions));
+  sequencer->offsets = malloc(step_count * sizeof(*sequencer->offsets));
+  sequencer->write_start = malloc((step_count + 1) * sizeof(*sequencer->write_start));
+  sequencer->lateness = malloc(step_count * sizeof(*sequencer->lateness));
+  sequencer->first_masks = malloc(sequencer->board_count * sizeof(*sequencer->first_masks));
+  if (sequencer->regions == NULL || sequencer->offsets == NULL ||
+      sequencer->write_start == NULL || sequencer->lateness == NULL ||
+      sequencer->first_masks == NULL) {
+    printf("v210_sequencer_create: Failed to allocate memory for sequence\n");
+    v210_sequencer_delete(sequencer);
+    return NULL;
+  }
+
+  for (size_t board = 0; board < sequencer->board_count; board++) {
+    v210_matrix_get_region(matrix, board, &sequencer->regions[board]);
+  }
+
+  if (v210_sequencer_compile(sequencer, steps) < 0) {
+    printf("v210_sequencer_create: Failed to compile sequence\n");
+    v210_sequencer_delete(sequencer);
+    return NULL;
+  }
+
+  return sequencer;
+}
+
+void v210_sequencer_delete(v210_sequencer_t* restrict sequencer) {
+  if (sequencer == NULL) return;
+  v210_sequencer_stop(sequencer);
+  free(sequencer->regions);
+  free(sequencer->offsets);
+  free(sequencer->write_start);
+  free(sequencer->writes);
+  free(sequencer->lateness);
+  free(sequencer->first_masks);
+  free(sequencer);
+}
+
+/**
+ * Sleeps until an absolute CLOCK_MONOTONIC deadline or until a stop is requested.
+ *
+ * @param  sequencer   Sequencer.
+ * @param  deadline_ns Absolute deadline in nanoseconds.
+ * @return 0 once the deadline is reached, -1 if a stop was requested.
+ */
+static int v210_sequencer_sleep_until(v210_sequencer_t* restrict sequencer,
+    uint64_t deadline_ns) {
+  for (;;) {
+    if (atomic_load_explicit(&sequencer->stop_requested, memory_order_relaxed)) return -1;
+    uint64_t now_ns = v210_get_time_ns();
+    if (now_ns >= deadline_ns) return 0;
+    uint64_t wake_ns = deadline_ns;
+    if (wake_ns - now_ns > V210_SEQUENCER_STOP_POLL_NS) wake_ns = now_ns + V210_SEQUENCER_STOP_POLL_NS;
+    struct timespec wake = {
+      .tv_sec = (time_t)(wake_ns / 1000000000ULL),
+      .tv_nsec = (long)(wake_ns % 1000000000ULL),
+    };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+  }
+}
+
+/**
+ * Sequencer thread: executes each step at its absolute deadline.
+ *
+ * @param  arg Sequencer.
+ * @return NULL.
+ */
+static void* v210_sequencer_run(void* arg) {
+  v210_sequencer_t* sequencer = (v210_sequencer_t*)arg;
+  for (size_t step = 0; step < sequencer->step_count; step++) {
+    uint64_t deadline_ns = sequencer->start_ns + sequencer->offsets[step];
+    if (v210_sequencer_sleep_until(sequencer, deadline_ns) < 0) break;
+
+    uint64_t now_ns = v210_get_time_ns();
+    sequencer->lateness[step] = now_ns - deadline_ns;
+    const size_t end = (step == 0) ?
+        sequencer->first_write_count : sequencer->write_start[step + 1];
+    for (size_t i = sequencer->write_start[step]; i < end; i++) {
+      const v210_sequencer_write_t* write = &sequencer->writes[i];
+      if (v210_write_relay_word(sequencer->regions[write->board], write->word, write->value) < 0) {
+        sequencer->status = -2;
+        return NULL;
+      }
+    }
+    atomic_store_explicit(&sequencer->steps_executed, step + 1, memory_order_release);
+  }
+  return NULL;
+}
+
+int v210_sequencer_start(v210_sequencer_t* restrict sequencer) {
+  if (sequencer == NULL || sequencer->thread_active) return -1;
+  if (v210_sequencer_compile_first(sequencer) < 0) {
+    printf("v210_sequencer_start: Failed to read relay shadow\n");
+    return -1;
+  }
+  atomic_store(&sequencer->steps_executed, 0);
+  atomic_store(&sequencer->stop_requested, false);
+  sequencer->status = 0;
+  sequencer->start_ns = v210_get_time_ns();
+  if (pthread_create(&sequencer->thread, NULL, v210_sequencer_run, sequencer) != 0) {
+    printf("v210_sequencer_start: Failed to create sequencer thread\n");
+    return -1;
+  }
+  sequencer->thread_active = true;
+  return 0;
+}
+
+int v210_sequencer_wait(v210_sequencer_t* restrict sequencer) {
+  if (sequencer == NULL) return -1;
+  if (sequencer->thread_active) {
+    if (pthread_join(sequencer->thread, NULL) != 0) return -1;
+    sequencer->thread_active = false;
+  }
+  return sequencer->status;
+}
+
+int v210_sequencer_stop(v210_sequencer_t* restrict sequencer) {
+  if (sequencer == NULL) return -1;
+  atomic_store(&sequencer->stop_requested, true);
+  return (v210_sequencer_wait(sequencer) == -1) ? -1 : 0;
+}
+
+int v210_sequencer_get_lateness(const v210_sequencer_t* restrict sequencer, size_t step,
+    uint64_t* restrict lateness_ns) {
+  if (sequencer == NULL) return -1;
+  size_t executed = atomic_load_explicit(&sequencer->steps_executed, memory_order_acquire);
+  if (step >= executed) return -1;
+  *lateness_ns = sequencer->lateness[step];
+  return 0;
+}
+
+int v210_sequencer_get_report(const v210_sequencer_t* restrict sequencer,
+    v210_sequence_report_t* restrict report) {
+  if (sequencer == NULL) return -1;
+  size_t executed = atomic_load_explicit(&sequencer->steps_executed, memory_order_acquire);
+  memset(report, 0, sizeof(*report));
+  report->steps_executed = executed;
+  if (executed > 0) {
+    report->writes_issued = sequencer->first_write_count +
+        sequencer->write_start[executed] - sequencer->write_start[1];
+  }
+  for (size_t step = 0; step < executed; step++) {
+    if (sequencer->lateness[step] > report->max_lateness_ns) {
+      report->max_lateness_ns = sequencer->lateness[step];
+    }
+    report->total_lateness_ns += sequencer->lateness[step];
+  }
+  return 0;
+}
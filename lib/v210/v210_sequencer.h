@@ -0,0 +1,127 @@
+/**
+ * Public API for executing timed relay sequences on a V210 relay matrix.
+ *
+ * A sequence is a list of steps, each holding a time offset from the start of the sequence and
+ * the relay states of every board in the matrix. Steps are precompiled into the minimal list of
+ * ctl[] word writes and executed on a dedicated thread against absolute CLOCK_MONOTONIC deadlines,
+ * so that timing errors do not accumulate from step to step.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "v210_matrix.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V210 Sequence Step. */
+typedef struct v210_sequence_step_t {
+  uint64_t offset_ns;      /** Time of the step relative to the start of the sequence. */
+  const uint64_t* masks;   /** One 64-bit relay mask per board of the matrix. */
+} v210_sequence_step_t;
+
+/** V210 Sequence Execution Report. */
+typedef struct v210_sequence_report_t {
+  size_t steps_executed;       /** Number of steps whose writes were issued. */
+  size_t writes_issued;        /** Number of ctl[] word writes issued. */
+  uint64_t max_lateness_ns;    /** Largest delay between a step deadline and its first write. */
+  uint64_t total_lateness_ns;  /** Sum of all step lateness values. */
+} v210_sequence_report_t;
+
+/** V210 Relay Sequencer (opaque). */
+typedef struct v210_sequencer_t v210_sequencer_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates a sequencer and precompiles the steps into per-board ctl[] word writes. Later steps only
+ * write the words that differ from the previous step; the first step is compiled at each start
+ * and only writes the words that differ from the relay shadow. The step masks are copied and need
+ * not outlive the call.
+ *
+ * @param  matrix     Relay matrix to drive. Must outlive the sequencer.
+ * @param  steps      Sequence steps, with non-decreasing time offsets.
+ * @param  step_count Number of steps.
+ * @return Pointer to the sequencer, or NULL on failure.
+ */
+v210_sequencer_t* v210_sequencer_create(
+  v210_matrix_t* restrict matrix,
+  const v210_sequence_step_t* restrict steps,
+  size_t step_count
+);
+
+/**
+ * Deletes a sequencer, stopping it first if it is running.
+ *
+ * @param  sequencer Sequencer to delete.
+ */
+void v210_sequencer_delete(v210_sequencer_t* restrict sequencer);
+
+/**
+ * Starts executing the sequence on a dedicated thread. Step offsets are measured from this call.
+ *
+ * @param  sequencer Sequencer to start.
+ * @return 0 on success, non-zero on failure (including if it is already running).
+ */
+int v210_sequencer_start(v210_sequencer_t* restrict sequencer);
+
+/**
+ * Waits for the sequence to finish.
+ *
+ * @param  sequencer Sequencer to wait for.
+ * @return 0 on success, -1 on failure, -2 if a relay write failed during the sequence.
+ */
+int v210_sequencer_wait(v210_sequencer_t* restrict sequencer);
+
+/**
+ * Stops the sequence before its next step and waits for the thread to exit.
+ *
+ * @param  sequencer Sequencer to stop.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_sequencer_stop(v210_sequencer_t* restrict sequencer);
+
+/**
+ * Gets the lateness of a step: the delay between its deadline and its first write.
+ *
+ * @param  sequencer   Sequencer to query.
+ * @param  step        Step index.
+ * @param  lateness_ns Storage for the lateness in nanoseconds.
+ * @return 0 on success, non-zero on failure (including if the step has not executed).
+ */
+int v210_sequencer_get_lateness(
+  const v210_sequencer_t* restrict sequencer,
+  size_t step,
+  uint64_t* restrict lateness_ns
+);
+
+/**
+ * Gets the execution report of the last (or current) run of the sequence.
+ *
+ * @param  sequencer Sequencer to query.
+ * @param  report    Storage for the report.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_sequencer_get_report(
+  const v210_sequencer_t* restrict sequencer,
+  v210_sequence_report_t* restrict report
+);
@@ -0,0 +1,139 @@
+/**
+ * Implementation of the V210 Relay Wear Counters.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "v210.h"
+#include "v210_wear.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Wear counter file magic ("V21W"). */
+#define V210_WEAR_MAGIC 0x57313256
+
+#define V210_WEAR_VERSION 1
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Layout of the wear counter file. */
+typedef struct v210_wear_file_t {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t board_id;
+  uint32_t vme_addr;
+  uint32_t reserved;
+  uint64_t total;
+  uint64_t counts[V210_CHANNEL_COUNT];
+} v210_wear_file_t;
+
+/** V210 Relay Wear Counters. */
+struct v210_wear_t {
+  v210_wear_file_t* file;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+v210_wear_t* v210_wear_open(const char* restrict directory, uint16_t board_id, uint32_t vme_addr) {
+  if (directory == NULL) return NULL;
+
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/v210_wear_%04X_%08X.dat", directory, board_id, vme_addr);
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    printf("v210_wear_open: Failed to open %s\n", path);
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 ||
+      ((size_t)st.st_size < sizeof(v210_wear_file_t) &&
+       ftruncate(fd, sizeof(v210_wear_file_t)) < 0)) {
+    printf("v210_wear_open: Failed to size %s\n", path);
+    close(fd);
+    return NULL;
+  }
+
+  v210_wear_file_t* file = mmap(NULL, sizeof(v210_wear_file_t), PROT_READ | PROT_WRITE,
+      MAP_SHARED, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    printf("v210_wear_open: Failed to map %s\n", path);
+    return NULL;
+  }
+
+  if (file->magic != V210_WEAR_MAGIC || file->version != V210_WEAR_VERSION) {
+    memset(file, 0, sizeof(v210_wear_file_t));
+    file->version = V210_WEAR_VERSION;
+    file->board_id = board_id;
+    file->vme_addr = vme_addr;
+    file->magic = V210_WEAR_MAGIC;
+  }
+
+  v210_wear_t* wear = malloc(sizeof(v210_wear_t));
+  if (wear == NULL) {
+    printf("v210_wear_open: Failed to allocate memory for wear counters\n");
+    munmap(file, sizeof(v210_wear_file_t));
+    return NULL;
+  }
+  wear->file = file;
+  return wear;
+}
+
+void v210_wear_close(v210_wear_t* restrict wear) {
+  if (wear == NULL) return;
+  msync(wear->file, sizeof(v210_wear_file_t), MS_SYNC);
+  munmap(wear->file, sizeof(v210_wear_file_t));
+  free(wear);
+}
+
+void v210_wear_record(v210_wear_t* restrict wear, uint8_t word, uint16_t changed) {
+  if (wear == NULL || changed == 0) return;
+  /** ctl[3] holds channels 0 - 15 and ctl[0] holds channels 48 - 63. */
+  uint64_t* counts = &wear->file->counts[(V210_RELAY_WORD_COUNT - 1 - word) * 16];
+  wear->file->total += (uint64_t)__builtin_popcount(changed);
+  unsigned int bits = changed;
+  while (bits != 0) {
+    counts[__builtin_ctz(bits)]++;
+    bits &= bits - 1;
+  }
+}
+
+int v210_wear_flush(v210_wear_t* restrict wear) {
+  if (wear == NULL) return -1;
+  return (msync(wear->file, sizeof(v210_wear_file_t), MS_ASYNC) < 0) ? -1 : 0;
+}
+
+int v210_wear_get_count(const v210_wear_t* restrict wear, uint8_t channel,
+    uint64_t* restrict count) {
+  if (wear == NULL || channel >= V210_CHANNEL_COUNT) return -1;
+  *count = wear->file->counts[channel];
+  return 0;
+}
+
+int v210_wear_get_total(const v210_wear_t* restrict wear, uint64_t* restrict total) {
+  if (wear == NULL) return -1;
+  *total = wear->file->total;
+  return 0;
+}
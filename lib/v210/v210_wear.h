@@ -0,0 +1,89 @@
+/**
+ * Public API for persistent V210 relay actuation counters.
+ *
+ * Counters live in a small memory-mapped file per module, keyed by board ID and VME address, so
+ * they survive restarts. Updating them is a few memory operations per changed relay and involves
+ * no system calls; v210_wear_flush() schedules write-back to disk.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V210 Relay Wear Counters (opaque). */
+typedef struct v210_wear_t v210_wear_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Opens (creating if needed) the wear counter file of a V210 module and maps it into memory. The
+ * file is named v210_wear_<board_id>_<vme_addr>.dat, in hexadecimal, inside the given directory.
+ *
+ * @param  directory Directory holding the counter files.
+ * @param  board_id  Board ID of the V210 module.
+ * @param  vme_addr  VME base address of the V210 module.
+ * @return Pointer to the wear counters, or NULL on failure.
+ */
+v210_wear_t* v210_wear_open(const char* restrict directory, uint16_t board_id, uint32_t vme_addr);
+
+/**
+ * Flushes and unmaps the wear counters.
+ *
+ * @param  wear Wear counters to close.
+ */
+void v210_wear_close(v210_wear_t* restrict wear);
+
+/**
+ * Counts one actuation for each relay whose bit is set in the changed bits of a ctl[] word.
+ *
+ * @param  wear    Wear counters.
+ * @param  word    ctl[] register index (0 - 3).
+ * @param  changed XOR of the old and new values of the ctl[] word.
+ */
+void v210_wear_record(v210_wear_t* restrict wear, uint8_t word, uint16_t changed);
+
+/**
+ * Schedules write-back of the counters to disk without waiting for it.
+ *
+ * @param  wear Wear counters.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_wear_flush(v210_wear_t* restrict wear);
+
+/**
+ * Gets the actuation count of a single relay.
+ *
+ * @param  wear    Wear counters.
+ * @param  channel Channel number (0 - 63).
+ * @param  count   Storage for the actuation count.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_wear_get_count(const v210_wear_t* restrict wear, uint8_t channel, uint64_t* restrict count);
+
+/**
+ * Gets the total actuation count over all relays of the module.
+ *
+ * @param  wear  Wear counters.
+ * @param  total Storage for the total actuation count.
+ * @return 0 on success, non-zero on failure.
+ */
+int v210_wear_get_total(const v210_wear_t* restrict wear, uint64_t* restrict total);
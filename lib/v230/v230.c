@@ -24,6 +24,9 @@
 
 #endif
 
+/** Alignment of region storage. */
+#define V230_CACHE_LINE_SIZE 64
+
 #define V230_RNG1_SCALE_FACTOR (0.1024 / 32768.0)
 #define V230_RNG2_SCALE_FACTOR (1.024 / 32768.0)
 #define V230_RNG3_SCALE_FACTOR (10.24 / 32768.0)
@@ -68,27 +71,47 @@ static int v230_validate_address_and_mode(const uint32_t vme_addr, const V120_PD
   return 0;
 }
 
+/**
+ * Gets the offset of the per-region data within the storage of a region.
+ *
+ * @return Offset in bytes, a multiple of the cache line size.
+ */
+static inline size_t v230_region_data_offset(void) {
+  return (sizeof(VME_REGION) + V230_CACHE_LINE_SIZE - 1) & ~(size_t)(V230_CACHE_LINE_SIZE - 1);
+}
+
+size_t v230_get_region_storage_size(void) {
+  const size_t size = v230_region_data_offset() + sizeof(v230_channel_data_t);
+  return (size + V230_CACHE_LINE_SIZE - 1) & ~(size_t)(V230_CACHE_LINE_SIZE - 1);
+}
+
 VME_REGION* v230_add_region(V120_HANDLE* restrict hV120, const uint32_t vme_addr, 
     const V120_PD addr_mode, const char* restrict name) {
-  
-  if (v230_validate_address_and_mode(vme_addr, addr_mode) < 0) return NULL;
 
-  VME_REGION* v230_region = malloc(sizeof(VME_REGION));
-  if (v230_region == NULL) {
+  /** The region and its data share one cache-aligned allocation. */
+  void* storage = aligned_alloc(V230_CACHE_LINE_SIZE, v230_get_region_storage_size());
+  if (storage == NULL) {
     printf("v230_add_region: Failed to allocate memory for VME_REGION\n");
     return NULL;
   }
 
-  v230_channel_data_t* channel_data = malloc(sizeof(v230_channel_data_t));
-  if (channel_data == NULL) {
-    printf("v230_add_region: Failed to allocate memory for channel data\n");
-    free(v230_region);
-    return NULL;
-  }
+  VME_REGION* v230_region = v230_add_region_at(hV120, vme_addr, addr_mode, name, storage);
+  if (v230_region == NULL) free(storage);
+  return v230_region;
+}
+
+VME_REGION* v230_add_region_at(V120_HANDLE* restrict hV120, const uint32_t vme_addr,
+    const V120_PD addr_mode, const char* restrict name, void* restrict storage) {
+
+  if (storage == NULL || ((uintptr_t)storage % V230_CACHE_LINE_SIZE) != 0) return NULL;
+  if (v230_validate_address_and_mode(vme_addr, addr_mode) < 0) return NULL;
+
+  VME_REGION* v230_region = (VME_REGION*)storage;
+  v230_channel_data_t* channel_data =
+      (v230_channel_data_t*)((char*)storage + v230_region_data_offset());
 
   memset(v230_region, 0, sizeof(VME_REGION));
   memset(channel_data, 0, sizeof(v230_channel_data_t));
-
   v230_region->base = NULL;
   v230_region->start_page = v230_region->end_page = 0;
   v230_region->vme_addr = vme_addr;
@@ -99,8 +122,8 @@ VME_REGION* v230_add_region(V120_HANDLE* restrict hV120, const uint32_t vme_addr
 
   VME_REGION* data = v120_add_vme_region(hV120, v230_region);
   if (data == NULL) {
-    printf("v230_add_region: Failed to add VME region\n");
-    v230_delete_region(v230_region);
+    printf("v230_add_region_at: Failed to add VME region\n");
+    v230_release_region(v230_region);
     return NULL;
   }
 
@@ -108,11 +131,14 @@ VME_REGION* v230_add_region(V120_HANDLE* restrict hV120, const uint32_t vme_addr
 }
 
 void v230_delete_region(VME_REGION* restrict v230_region) {
-  if (v230_region->udata != NULL) {
-    free(v230_region->udata);
-    v230_region->udata = NULL;
-  }
-  if (v230_region != NULL) free(v230_region);
+  if (v230_region == NULL) return;
+  v230_release_region(v230_region);
+  free(v230_region);
+}
+
+void v230_release_region(VME_REGION* restrict v230_region) {
+  if (v230_region == NULL) return;
+  v230_region->udata = NULL;
 }
 
 /**
@@ -202,6 +202,32 @@ VME_REGION* v230_add_region(
   const char* restrict name
 );
 
+/**
+ * Gets the size of the storage that v230_add_region_at() needs for one region.
+ *
+ * @return Size in bytes, a multiple of the cache line size.
+ */
+size_t v230_get_region_storage_size(void);
+
+/**
+ * Adds a VME region for the V230 module in caller-provided storage instead of allocating it. The
+ * storage must stay valid until the region is released with v230_release_region().
+ *
+ * @param  hV120     Handle to the V120 library.
+ * @param  vme_addr  Base address of the V230 module.
+ * @param  addr_mode Addressing mode (A16, A24).
+ * @param  name      Name of the VME region.
+ * @param  storage   Cache-line aligned storage of v230_get_region_storage_size() bytes.
+ * @return Pointer to the VME region (at the start of storage), or NULL on failure.
+ */
+VME_REGION* v230_add_region_at(
+  V120_HANDLE* restrict hV120,
+  const uint32_t vme_addr,
+  const V120_PD addr_mode,
+  const char* restrict name,
+  void* restrict storage
+);
+
 /**
  * Deletes the VME region of the V230 module.
  * 
@@ -209,6 +235,13 @@ VME_REGION* v230_add_region(
  */
 void v230_delete_region(VME_REGION* restrict v230_region);
 
+/**
+ * Releases a VME region added with v230_add_region_at() without freeing its storage.
+ *
+ * @param  v230_region VME region of the V230 module.
+ */
+void v230_release_region(VME_REGION* restrict v230_region);
+
 /***************************************************************************************************
  * V230 Test Registers
  **************************************************************************************************/
@@ -6,6 +6,7 @@
  * INCLUDES
  **************************************************************************************************/
 
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -19,12 +20,32 @@
 
 #define V280_CHANNELS_PER_REGISTER 16
 
+/** Alignment of region storage. */
+#define V280_CACHE_LINE_SIZE 64
+
 #define V280_BIST_MACRO_CODE 0x8401
 
+#define V280_MACRO_BUSY_BIT 15
+
+/** Backoff bounds between BIST completion polls of a crate. */
+#define V280_BIST_POLL_MIN_NS 10000L
+#define V280_BIST_POLL_MAX_NS 1000000L
+
 /***************************************************************************************************
  * TYPES
  **************************************************************************************************/
 
+/** V280 Per-Region Data. */
+typedef struct v280_region_data_t {
+  /** Stable input state snapshot counters, updated from any thread. */
+  atomic_uint_fast64_t snapshot_reads;
+  atomic_uint_fast64_t snapshot_retries;
+  atomic_uint_fast64_t snapshot_failures;
+  /** Shadow of rise[] and fall[] as last written or read, valid once debounce_valid is set. */
+  v280_debounce_config_t debounce;
+  bool debounce_valid;
+} v280_region_data_t;
+
 /***************************************************************************************************
  * VARIABLES
  **************************************************************************************************/
@@ -55,30 +76,62 @@ static int v280_validate_address_and_mode(const uint32_t vme_addr, const V120_PD
   return 0;
 }
 
+/**
+ * Gets the offset of the per-region data within the storage of a region.
+ *
+ * @return Offset in bytes, a multiple of the cache line size.
+ */
+static inline size_t v280_region_data_offset(void) {
+  return (sizeof(VME_REGION) + V280_CACHE_LINE_SIZE - 1) & ~(size_t)(V280_CACHE_LINE_SIZE - 1);
+}
+
+size_t v280_get_region_storage_size(void) {
+  const size_t size = v280_region_data_offset() + sizeof(v280_region_data_t);
+  return (size + V280_CACHE_LINE_SIZE - 1) & ~(size_t)(V280_CACHE_LINE_SIZE - 1);
+}
+
 VME_REGION* v280_add_region(V120_HANDLE* restrict hV120, const uint32_t vme_addr, 
     const V120_PD addr_mode, const char* restrict name) {
 
-  if (v280_validate_address_and_mode(vme_addr, addr_mode) < 0) return NULL;
-
-  VME_REGION* v280_region = malloc(sizeof(VME_REGION));
-  if (v280_region == NULL) {
+  /** The region and its data share one cache-aligned allocation. */
+  void* storage = aligned_alloc(V280_CACHE_LINE_SIZE, v280_get_region_storage_size());
+  if (storage == NULL) {
     printf("v280_add_region: Failed to allocate memory for VME_REGION\n");
     return NULL;
   }
 
+  VME_REGION* v280_region = v280_add_region_at(hV120, vme_addr, addr_mode, name, storage);
+  if (v280_region == NULL) free(storage);
+  return v280_region;
+}
+
+VME_REGION* v280_add_region_at(V120_HANDLE* restrict hV120, const uint32_t vme_addr,
+    const V120_PD addr_mode, const char* restrict name, void* restrict storage) {
+
+  if (storage == NULL || ((uintptr_t)storage % V280_CACHE_LINE_SIZE) != 0) return NULL;
+  if (v280_validate_address_and_mode(vme_addr, addr_mode) < 0) return NULL;
+
+  VME_REGION* v280_region = (VME_REGION*)storage;
+  v280_region_data_t* region_data =
+      (v280_region_data_t*)((char*)storage + v280_region_data_offset());
+
   memset(v280_region, 0, sizeof(VME_REGION));
+  memset(region_data, 0, sizeof(v280_region_data_t));
+  atomic_init(&region_data->snapshot_reads, 0);
+  atomic_init(&region_data->snapshot_retries, 0);
+  atomic_init(&region_data->snapshot_failures, 0);
   v280_region->base = NULL;
   v280_region->start_page = v280_region->end_page = 0;
   v280_region->vme_addr = vme_addr;
   v280_region->len = sizeof(v280_registers);
   v280_region->config = addr_mode | V120_SMAX | V120_EAUTO | V120_RW | V120_D16;
   v280_region->tag = name;
-  v280_region->udata = NULL;
+  v280_region->udata = (void *)region_data;
 
   VME_REGION* data = v120_add_vme_region(hV120, v280_region);
   if (data == NULL) {
-    printf("v280_add_region: Failed to add VME region\n");
-    free(v280_region);
+    printf("v280_add_region_at: Failed to add VME region\n");
+    v280_release_region(v280_region);
     return NULL;
   }
 
@@ -86,7 +139,14 @@ VME_REGION* v280_add_region(V120_HANDLE* restrict hV120, const uint32_t vme_addr
 }
 
 void v280_delete_region(VME_REGION* restrict v280_region) {
-  if (v280_region != NULL) free(v280_region);
+  if (v280_region == NULL) return;
+  v280_release_region(v280_region);
+  free(v280_region);
+}
+
+void v280_release_region(VME_REGION* restrict v280_region) {
+  if (v280_region == NULL) return;
+  v280_region->udata = NULL;
 }
 
 /**
@@ -99,6 +159,32 @@ static inline volatile v280_registers* v280_get_registers(VME_REGION* restrict v
   return (v280_registers *)v280_region->base;
 }
 
+/**
+ * Gets the DMA address space flag matching the addressing mode of the region.
+ * 
+ * @param  v280_region VME region of the V280 module.
+ * @return V120_PD_A24 or V120_PD_A16.
+ */
+static inline uint32_t v280_dma_space(const VME_REGION* restrict v280_region) {
+  return ((v280_region->config & V120_A24) == V120_A24) ? V120_PD_A24 : V120_PD_A16;
+}
+
+uint64_t v280_get_time_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Gets a pointer to the per-region data of the V280 module.
+ * 
+ * @param  v280_region VME region of the V280 module.
+ * @return Pointer to the per-region data.
+ */
+static inline v280_region_data_t* v280_get_region_data(VME_REGION* restrict v280_region) {
+  return (v280_region_data_t *)v280_region->udata;
+}
+
 /***************************************************************************************************
  * V280 Overhead Information
  **************************************************************************************************/
@@ -200,22 +286,87 @@ int v280_get_uled(VME_REGION* restrict v280_region, uint16_t* restrict pattern)
  * V280 Input State and Debounce Times
  **************************************************************************************************/
 
+/**
+ * Reads state[0..2] into a 48-bit mask with state[0] in the high word.
+ * 
+ * @param  regs V280 registers.
+ * @return 48-bit input states.
+ */
+static inline uint64_t v280_read_state_words(volatile v280_registers* restrict regs) {
+  uint64_t states = 0;
+  for (uint8_t i = 0; i < 3; i++) {
+    states <<= V280_CHANNELS_PER_REGISTER;
+    states |= regs->state[i];
+  }
+  return states;
+}
+
 int v280_get_input_states(VME_REGION* restrict v280_region, uint64_t* restrict states) {
   if (v280_region == NULL) return -1;
+  *states = v280_read_state_words(v280_get_registers(v280_region));
+  return 0;
+}
+
+int v280_get_input_states_stable(VME_REGION* restrict v280_region, uint8_t max_retries, 
+    uint64_t* restrict states) {
+  if (v280_region == NULL) return -1;
+  v280_region_data_t* region_data = v280_get_region_data(v280_region);
+  if (region_data == NULL) return -1;
   volatile v280_registers* regs = v280_get_registers(v280_region);
-  *states = 0;
-  for (uint8_t i = 0; i < 3; i++) {
-    *states <<= V280_CHANNELS_PER_REGISTER;
-    *states |= regs->state[i];
+
+  /** 
+   * The three words are separate bus cycles, so a change between them can produce a combination
+   * that never existed. A value is only accepted once two consecutive reads agree.
+   */
+  uint64_t previous = v280_read_state_words(regs);
+  uint64_t current = v280_read_state_words(regs);
+  uint8_t retries = 0;
+  while (current != previous && retries < max_retries) {
+    previous = current;
+    current = v280_read_state_words(regs);
+    retries++;
+  }
+
+  atomic_fetch_add_explicit(&region_data->snapshot_reads, 1, memory_order_relaxed);
+  if (retries != 0) {
+    atomic_fetch_add_explicit(&region_data->snapshot_retries, retries, memory_order_relaxed);
   }
+  if (current != previous) {
+    atomic_fetch_add_explicit(&region_data->snapshot_failures, 1, memory_order_relaxed);
+    return -2;
+  }
+  *states = current;
+  return 0;
+}
+
+int v280_get_snapshot_stats(VME_REGION* restrict v280_region, 
+    v280_snapshot_stats_t* restrict stats) {
+  if (v280_region == NULL || stats == NULL) return -1;
+  v280_region_data_t* region_data = v280_get_region_data(v280_region);
+  if (region_data == NULL) return -1;
+  stats->reads = atomic_load_explicit(&region_data->snapshot_reads, memory_order_relaxed);
+  stats->retries = atomic_load_explicit(&region_data->snapshot_retries, memory_order_relaxed);
+  stats->failures = atomic_load_explicit(&region_data->snapshot_failures, memory_order_relaxed);
+  return 0;
+}
+
+int v280_reset_snapshot_stats(VME_REGION* restrict v280_region) {
+  if (v280_region == NULL) return -1;
+  v280_region_data_t* region_data = v280_get_region_data(v280_region);
+  if (region_data == NULL) return -1;
+  atomic_store_explicit(&region_data->snapshot_reads, 0, memory_order_relaxed);
+  atomic_store_explicit(&region_data->snapshot_retries, 0, memory_order_relaxed);
+  atomic_store_explicit(&region_data->snapshot_failures, 0, memory_order_relaxed);
   return 0;
 }
 
 int v280_set_rise_time_delay(VME_REGION* restrict v280_region, uint8_t channel, uint16_t delay) {
   if (v280_region == NULL) return -1;
   if (channel >= V280_CHANNEL_COUNT) return -1;
-  uint8_t reg = channel / V280_CHANNELS_PER_REGISTER;
+  uint8_t reg = V280_DEBOUNCE_GROUP_OF_BIT(channel);
   v280_get_registers(v280_region)->rise[reg] = delay;
+  v280_region_data_t* region_data = v280_get_region_data(v280_region);
+  if (region_data != NULL) region_data->debounce.rise[reg] = delay;
   return 0;
 }
 
@@ -223,7 +374,7 @@ int v280_get_rise_time_delay(VME_REGION* restrict v280_region, uint8_t channel,
     uint16_t* restrict delay) {
   if (v280_region == NULL) return -1;
   if (channel >= V280_CHANNEL_COUNT) return -1;
-  uint8_t reg = channel / V280_CHANNELS_PER_REGISTER;
+  uint8_t reg = V280_DEBOUNCE_GROUP_OF_BIT(channel);
   *delay = v280_get_registers(v280_region)->rise[reg];
   return 0;
 }
@@ -231,8 +382,10 @@ int v280_get_rise_time_delay(VME_REGION* restrict v280_region, uint8_t channel,
 int v280_set_fall_time_delay(VME_REGION* restrict v280_region, uint8_t channel, uint16_t delay) {
   if (v280_region == NULL) return -1;
   if (channel >= V280_CHANNEL_COUNT) return -1;
-  uint8_t reg = channel / V280_CHANNELS_PER_REGISTER;
+  uint8_t reg = V280_DEBOUNCE_GROUP_OF_BIT(channel);
   v280_get_registers(v280_region)->fall[reg] = delay;
+  v280_region_data_t* region_data = v280_get_region_data(v280_region);
+  if (region_data != NULL) region_data->debounce.fall[reg] = delay;
   return 0;
 }
 
@@ -240,11 +393,73 @@ int v280_get_fall_time_delay(VME_REGION* restrict v280_region, uint8_t channel,
     uint16_t* restrict delay) {
   if (v280_region == NULL) return -1;
   if (channel >= V280_CHANNEL_COUNT) return -1;
-  uint8_t reg = channel / V280_CHANNELS_PER_REGISTER;
+  uint8_t reg = V280_DEBOUNCE_GROUP_OF_BIT(channel);
   *delay = v280_get_registers(v280_region)->fall[reg];
   return 0;
 }
 
+/**
+ * Reads rise[] and fall[] with a single DMA transfer of the registers between them.
+ * 
+ * @param  hV120       Handle to the V120 library.
+ * @param  v280_region VME region of the V280 module.
+ * @param  config      Pointer to store the debounce times.
+ * @return 0 on success, -1 on failure.
+ */
+static int v280_read_debounce_registers(V120_HANDLE* restrict hV120, 
+    VME_REGION* restrict v280_region, v280_debounce_config_t* restrict config) {
+  /** rise[0..2], unused, fall[0..2], unused */
+  uint16_t words[(offsetof(v280_registers, err) - offsetof(v280_registers, rise)) / 2];
+  struct v120_dma_desc_t desc = {
+    .flags = v280_dma_space(v280_region) | V120_PD_D16 | V120_PD_ESHORT,
+    .ptr = (__u64)(uintptr_t)words,
+    .size = sizeof(words),
+    .next = 0LL,
+    .vme_address = v280_region->vme_addr + offsetof(v280_registers, rise),
+  };
+  if (v120_dma_xfr(hV120, &desc) < 0) return -1;
+  const size_t fall_index = (offsetof(v280_registers, fall) - offsetof(v280_registers, rise)) / 2;
+  for (uint8_t i = 0; i < V280_DEBOUNCE_GROUP_COUNT; i++) {
+    config->rise[i] = words[i];
+    config->fall[i] = words[fall_index + i];
+  }
+  return 0;
+}
+
+int v280_set_debounce_config(V120_HANDLE* restrict hV120, VME_REGION* restrict v280_region, 
+    const v280_debounce_config_t* restrict config) {
+  if (hV120 == NULL || v280_region == NULL || config == NULL) return -1;
+  v280_region_data_t* region_data = v280_get_region_data(v280_region);
+  if (region_data == NULL) return -1;
+  volatile v280_registers* regs = v280_get_registers(v280_region);
+
+  const bool force = !region_data->debounce_valid;
+  for (uint8_t i = 0; i < V280_DEBOUNCE_GROUP_COUNT; i++) {
+    if (force || config->rise[i] != region_data->debounce.rise[i]) regs->rise[i] = config->rise[i];
+    if (force || config->fall[i] != region_data->debounce.fall[i]) regs->fall[i] = config->fall[i];
+  }
+
+  /** The shadow follows the hardware, so a failed verify is retried in full next time. */
+  if (v280_read_debounce_registers(hV120, v280_region, &region_data->debounce) < 0) {
+    region_data->debounce_valid = false;
+    return -1;
+  }
+  region_data->debounce_valid = true;
+  if (memcmp(&region_data->debounce, config, sizeof(v280_debounce_config_t)) != 0) return -2;
+  return 0;
+}
+
+int v280_get_debounce_config(V120_HANDLE* restrict hV120, VME_REGION* restrict v280_region, 
+    v280_debounce_config_t* restrict config) {
+  if (hV120 == NULL || v280_region == NULL || config == NULL) return -1;
+  v280_region_data_t* region_data = v280_get_region_data(v280_region);
+  if (region_data == NULL) return -1;
+  if (v280_read_debounce_registers(hV120, v280_region, config) < 0) return -1;
+  region_data->debounce = *config;
+  region_data->debounce_valid = true;
+  return 0;
+}
+
 /***************************************************************************************************
  * V280 BIST Error Flags
  **************************************************************************************************/
@@ -267,29 +482,160 @@ int v280_get_bist_error_flags(VME_REGION* restrict v280_region,
 
 int v280_write_buffer(VME_REGION* restrict v280_region, uint8_t index, uint16_t value) {
   if (v280_region == NULL) return -1;
+  if (index >= V280_BUFFER_SIZE) return -1;
   v280_get_registers(v280_region)->buf[index] = value;
   return 0;
 }
 
 int v280_read_buffer(VME_REGION* restrict v280_region, uint8_t index, uint16_t* restrict value) {
-  if (v280_region == NULL) return -1;
+  if (v280_region == NULL || value == NULL) return -1;
+  if (index >= V280_BUFFER_SIZE) return -1;
   *value = v280_get_registers(v280_region)->buf[index];
   return 0;
 }
 
+/**
+ * Checks that a buffer range lies within buf[].
+ * 
+ * @param  index First buffer index.
+ * @param  count Number of words.
+ * @return true if the range is valid.
+ */
+static inline bool v280_buffer_range_valid(uint8_t index, size_t count) {
+  return (index < V280_BUFFER_SIZE) && (count <= (size_t)(V280_BUFFER_SIZE - index));
+}
+
+int v280_read_buffer_range(V120_HANDLE* restrict hV120, VME_REGION* restrict v280_region, 
+    uint8_t index, size_t count, uint16_t* restrict values) {
+  if (hV120 == NULL || v280_region == NULL || values == NULL) return -1;
+  if (!v280_buffer_range_valid(index, count)) return -1;
+  if (count == 0) return 0;
+
+  struct v120_dma_desc_t desc = {
+    .flags = v280_dma_space(v280_region) | V120_PD_D16 | V120_PD_ESHORT,
+    .ptr = (__u64)(uintptr_t)values,
+    .size = count * sizeof(uint16_t),
+    .next = 0LL,
+    .vme_address = v280_region->vme_addr + offsetof(v280_registers, buf) + index * sizeof(uint16_t),
+  };
+  if (v120_dma_xfr(hV120, &desc) < 0) return -1;
+  return 0;
+}
+
+int v280_write_buffer_range(VME_REGION* restrict v280_region, uint8_t index, size_t count, 
+    const uint16_t* restrict values) {
+  if (v280_region == NULL || (values == NULL && count != 0)) return -1;
+  if (!v280_buffer_range_valid(index, count)) return -1;
+  /** v120_dma_desc_t has no host-to-VME direction, so writes are programmed I/O. */
+  volatile v280_registers* regs = v280_get_registers(v280_region);
+  for (size_t i = 0; i < count; i++) regs->buf[index + i] = values[i];
+  return 0;
+}
+
 /***************************************************************************************************
  * V280 Macro Control
  **************************************************************************************************/
 
-int v280_run_bist(VME_REGION* restrict v280_region) {
+int v280_start_bist(VME_REGION* restrict v280_region) {
   if (v280_region == NULL) return -1;
   volatile v280_registers* regs = v280_get_registers(v280_region);
-  if ((regs->macro >> 15) & 0x01) return -1;
-
+  if ((regs->macro >> V280_MACRO_BUSY_BIT) & 0x1) return -1;
   regs->macro = V280_BIST_MACRO_CODE;
+  return 0;
+}
+
+int v280_poll_bist(VME_REGION* restrict v280_region, bool* restrict done) {
+  if (v280_region == NULL || done == NULL) return -1;
+  uint16_t macro = v280_get_registers(v280_region)->macro;
+  *done = ((macro >> V280_MACRO_BUSY_BIT) & 0x1) == 0;
+  if (*done && ((macro >> 8) & 0xFF) != 0) return -2;
+  return 0;
+}
+
+int v280_collect_bist(V120_HANDLE* restrict hV120, VME_REGION* restrict v280_region, 
+    uint64_t* restrict error_flags) {
+  if (hV120 == NULL || v280_region == NULL || error_flags == NULL) return -1;
+  uint16_t err[3];
+  struct v120_dma_desc_t desc = {
+    .flags = v280_dma_space(v280_region) | V120_PD_D16 | V120_PD_ESHORT,
+    .ptr = (__u64)(uintptr_t)err,
+    .size = sizeof(err),
+    .next = 0LL,
+    .vme_address = v280_region->vme_addr + offsetof(v280_registers, err),
+  };
+  if (v120_dma_xfr(hV120, &desc) < 0) return -1;
+  *error_flags = 0;
+  for (uint8_t i = 0; i < 3; i++) {
+    *error_flags <<= V280_CHANNELS_PER_REGISTER;
+    *error_flags |= err[i];
+  }
+  return 0;
+}
+
+int v280_run_bist(VME_REGION* restrict v280_region) {
+  if (v280_start_bist(v280_region) < 0) return -1;
+
   /** This should resolve within 250 useconds. */
-  while ((regs->macro >> 15) & 0x1);
+  const uint64_t deadline_ns = v280_get_time_ns() + V280_BIST_TIMEOUT_US * 1000ULL;
+  bool done = false;
+  for (;;) {
+    int status = v280_poll_bist(v280_region, &done);
+    if (done || status != 0) return status;
+    if (v280_get_time_ns() >= deadline_ns) return -3;
+  }
+}
+
+int v280_run_bist_all(V120_HANDLE* restrict hV120, VME_REGION* const* restrict regions, 
+    size_t module_count, uint32_t timeout_us, v280_bist_result_t* restrict results) {
+  if (hV120 == NULL || regions == NULL || results == NULL) return -1;
+
+  /** Start every module first so that the self-tests run concurrently. */
+  const uint64_t start_ns = v280_get_time_ns();
+  const uint64_t deadline_ns = start_ns + (uint64_t)timeout_us * 1000ULL;
+  size_t pending = 0;
+  for (size_t module = 0; module < module_count; module++) {
+    results[module] = (v280_bist_result_t){ .status = 1 };
+    if (v280_start_bist(regions[module]) < 0) {
+      results[module].status = -1;
+    } else {
+      pending++;
+    }
+  }
 
-  if (((regs->macro >> 8) & 0xFF) != 0) return -2;
+  long backoff_ns = V280_BIST_POLL_MIN_NS;
+  while (pending != 0) {
+    for (size_t module = 0; module < module_count; module++) {
+      if (results[module].status != 1) continue;
+      bool done = false;
+      int status = v280_poll_bist(regions[module], &done);
+      if (!done && status == 0) continue;
+      results[module].status = status;
+      results[module].elapsed_ns = v280_get_time_ns() - start_ns;
+      if (v280_collect_bist(hV120, regions[module], &results[module].error_flags) < 0) {
+        results[module].status = -1;
+      }
+      pending--;
+    }
+    if (pending == 0) break;
+
+    if (v280_get_time_ns() >= deadline_ns) {
+      for (size_t module = 0; module < module_count; module++) {
+        if (results[module].status != 1) continue;
+        results[module].status = -3;
+        results[module].elapsed_ns = v280_get_time_ns() - start_ns;
+      }
+      break;
+    }
+
+    /** Poll often at first, when most modules finish, and back off for slow ones. */
+    const struct timespec delay = {0, backoff_ns};
+    nanosleep(&delay, NULL);
+    backoff_ns *= 2;
+    if (backoff_ns > V280_BIST_POLL_MAX_NS) backoff_ns = V280_BIST_POLL_MAX_NS;
+  }
+
+  for (size_t module = 0; module < module_count; module++) {
+    if (results[module].status != 0) return -2;
+  }
   return 0;
 }
@@ -9,6 +9,7 @@
  **************************************************************************************************/
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <V120.h>
 
@@ -18,10 +19,51 @@
 
 #define V280_CHANNEL_COUNT 48
 
+/** Number of 16-channel groups sharing a rise and fall debounce time. */
+#define V280_DEBOUNCE_GROUP_COUNT 3
+
+/**
+ * Debounce group, the index into rise[] and fall[], of a channel. Channel c is bit c of the 48-bit
+ * input state mask, which holds state[0] in its high word, and rise[g] and fall[g] debounce the
+ * inputs of state[g]: channels 32 - 47 are group 0 and channels 0 - 15 are group 2. Every API
+ * that maps a channel to its group uses this macro.
+ */
+#define V280_DEBOUNCE_GROUP_OF_BIT(bit) (V280_DEBOUNCE_GROUP_COUNT - 1 - (bit) / 16)
+
+/** Number of 16-bit words in the read/write buffer. */
+#define V280_BUFFER_SIZE 128
+
+/** Maximum time v280_run_bist() waits for the BIST to complete. */
+#define V280_BIST_TIMEOUT_US 10000
+
+/** Default number of extra reads allowed for a stable input state snapshot. */
+#define V280_SNAPSHOT_DEFAULT_RETRIES 4
+
 /***************************************************************************************************
  * TYPES
  **************************************************************************************************/
 
+/** V280 Input State Snapshot Statistics. */
+typedef struct v280_snapshot_stats_t {
+  uint64_t reads;     /** Number of stable snapshot reads. */
+  uint64_t retries;   /** Number of extra reads caused by inputs changing during a read. */
+  uint64_t failures;  /** Number of reads that did not stabilize within the retry limit. */
+} v280_snapshot_stats_t;
+
+/** V280 Debounce Configuration of all groups, in units of 10 microseconds. */
+typedef struct v280_debounce_config_t {
+  uint16_t rise[V280_DEBOUNCE_GROUP_COUNT];   /** Rise debounce time of the inputs of state[g]. */
+  uint16_t fall[V280_DEBOUNCE_GROUP_COUNT];   /** Fall debounce time of the inputs of state[g]. */
+} v280_debounce_config_t;
+
+/** V280 BIST Result of one module. */
+typedef struct v280_bist_result_t {
+  /** 0 if passed, -1 on failure to start or collect, -2 on BIST error, -3 on timeout. */
+  int status;
+  uint64_t error_flags;   /** 48-bit BIST error flags, valid unless status is -1 or -3. */
+  uint64_t elapsed_ns;    /** Time from the start of the crate run to completion. */
+} v280_bist_result_t;
+
 /***************************************************************************************************
  * VARIABLES
  **************************************************************************************************/
@@ -46,6 +88,32 @@ VME_REGION* v280_add_region(
   const char* restrict name
 );
 
+/**
+ * Gets the size of the storage that v280_add_region_at() needs for one region.
+ *
+ * @return Size in bytes, a multiple of the cache line size.
+ */
+size_t v280_get_region_storage_size(void);
+
+/**
+ * Adds a VME region for the V280 module in caller-provided storage instead of allocating it. The
+ * storage must stay valid until the region is released with v280_release_region().
+ *
+ * @param  hV120     Handle to the V120 library.
+ * @param  vme_addr  Base address of the V280 module.
+ * @param  addr_mode Addressing mode (A16, A24).
+ * @param  name      Name of the VME region.
+ * @param  storage   Cache-line aligned storage of v280_get_region_storage_size() bytes.
+ * @return Pointer to the VME region (at the start of storage), or NULL on failure.
+ */
+VME_REGION* v280_add_region_at(
+  V120_HANDLE* restrict hV120,
+  const uint32_t vme_addr,
+  const V120_PD addr_mode,
+  const char* restrict name,
+  void* restrict storage
+);
+
 /**
  * Deletes the VME region of the V280 module.
  * 
@@ -53,6 +121,20 @@ VME_REGION* v280_add_region(
  */
 void v280_delete_region(VME_REGION* restrict v280_region);
 
+/**
+ * Releases a VME region added with v280_add_region_at() without freeing its storage.
+ *
+ * @param  v280_region VME region of the V280 module.
+ */
+void v280_release_region(VME_REGION* restrict v280_region);
+
+/**
+ * Gets the current CLOCK_MONOTONIC time, the time base of every timestamp in the V280 library.
+ * 
+ * @return Current time in nanoseconds.
+ */
+uint64_t v280_get_time_ns(void);
+
 /***************************************************************************************************
  * V280 Overhead Information
  **************************************************************************************************/
@@ -203,11 +285,49 @@ int v280_get_uled(VME_REGION* restrict v280_region, uint16_t* restrict pattern);
  */
 int v280_get_input_states(VME_REGION* restrict v280_region, uint64_t* restrict states);
 
+/**
+ * Get a consistent snapshot of the input states of all channels. The three state registers are
+ * read as separate VME cycles, so v280_get_input_states() can return a combination of bits that
+ * never existed if an input changes between them. This reads all three registers repeatedly until
+ * two consecutive reads agree.
+ * 
+ * @param  v280_region VME region of the V280 module.
+ * @param  max_retries Maximum number of extra reads after the first two 
+ *                     (see V280_SNAPSHOT_DEFAULT_RETRIES).
+ * @param  states      Pointer to store the 48-bit value representing the states of all channels.
+ * @return 0 on success, -1 on failure, -2 if the inputs did not stabilize within max_retries.
+ */
+int v280_get_input_states_stable(
+  VME_REGION* restrict v280_region, 
+  uint8_t max_retries, 
+  uint64_t* restrict states
+);
+
+/**
+ * Get the statistics of v280_get_input_states_stable() for the V280 module.
+ * 
+ * @param  v280_region VME region of the V280 module.
+ * @param  stats       Pointer to store the snapshot statistics.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_get_snapshot_stats(
+  VME_REGION* restrict v280_region, 
+  v280_snapshot_stats_t* restrict stats
+);
+
+/**
+ * Reset the statistics of v280_get_input_states_stable() for the V280 module.
+ * 
+ * @param  v280_region VME region of the V280 module.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_reset_snapshot_stats(VME_REGION* restrict v280_region);
+
 /**
  * Set the rise time delay for the group of channels corresponding to the specified channel.
  * 
  * @param  v280_region VME region of the V280 module.
- * @param  channel     Channel number (0 - 47) to determine the group.
+ * @param  channel     Channel number (0 - 47); its group is V280_DEBOUNCE_GROUP_OF_BIT(channel).
  * @param  delay       Rise time delay in units of 10 microseconds.
  * @return 0 on success, non-zero on failure.
  */
@@ -217,7 +337,7 @@ int v280_set_rise_time_delay(VME_REGION* restrict v280_region, uint8_t channel,
  * Get the rise time delay for the group of channels corresponding to the specified channel.
  * 
  * @param  v280_region VME region of the V280 module.
- * @param  channel     Channel number (0 - 47) to determine the group.
+ * @param  channel     Channel number (0 - 47); its group is V280_DEBOUNCE_GROUP_OF_BIT(channel).
  * @param  delay       Pointer to store the rise time delay in units of 10 microseconds.
  * @return 0 on success, non-zero on failure.
  */
@@ -231,7 +351,7 @@ int v280_get_rise_time_delay(
  * Set the fall time delay for the group of channels corresponding to the specified channel.
  * 
  * @param  v280_region VME region of the V280 module.
- * @param  channel     Channel number (0 - 47) to determine the group.
+ * @param  channel     Channel number (0 - 47); its group is V280_DEBOUNCE_GROUP_OF_BIT(channel).
  * @param  delay       Fall time delay in units of 10 microseconds.
  * @return 0 on success, non-zero on failure.
  */
@@ -241,7 +361,7 @@ int v280_set_fall_time_delay(VME_REGION* restrict v280_region, uint8_t channel,
  * Get the fall time delay for the group of channels corresponding to the specified channel.
  * 
  * @param  v280_region VME region of the V280 module.
- * @param  channel     Channel number (0 - 47) to determine the group.
+ * @param  channel     Channel number (0 - 47); its group is V280_DEBOUNCE_GROUP_OF_BIT(channel).
  * @param  delay       Pointer to store the fall time delay in units of 10 microseconds.
  * @return 0 on success, non-zero on failure.
  */
@@ -251,6 +371,36 @@ int v280_get_fall_time_delay(
   uint16_t* restrict delay
 );
 
+/**
+ * Set the rise and fall debounce times of all groups. Only registers whose value differs from the
+ * last value written or read are written, and the result is verified with a single DMA read of
+ * rise[] and fall[].
+ * 
+ * @param  hV120       Handle to the V120 library.
+ * @param  v280_region VME region of the V280 module.
+ * @param  config      Debounce times to set.
+ * @return 0 on success, -1 on failure, -2 if the read back does not match.
+ */
+int v280_set_debounce_config(
+  V120_HANDLE* restrict hV120, 
+  VME_REGION* restrict v280_region, 
+  const v280_debounce_config_t* restrict config
+);
+
+/**
+ * Get the rise and fall debounce times of all groups with a single DMA read.
+ * 
+ * @param  hV120       Handle to the V120 library.
+ * @param  v280_region VME region of the V280 module.
+ * @param  config      Pointer to store the debounce times.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_get_debounce_config(
+  V120_HANDLE* restrict hV120, 
+  VME_REGION* restrict v280_region, 
+  v280_debounce_config_t* restrict config
+);
+
 /***************************************************************************************************
  * V280 BIST Error Flags
  **************************************************************************************************/
@@ -289,14 +439,101 @@ int v280_write_buffer(VME_REGION* restrict v280_region, uint8_t index, uint16_t
  */
 int v280_read_buffer(VME_REGION* restrict v280_region, uint8_t index, uint16_t* restrict value);
 
+/**
+ * Reads a range of the buffer with a single DMA transfer.
+ * 
+ * @param  hV120       Handle to the V120 library.
+ * @param  v280_region VME region of the V280 module.
+ * @param  index       First buffer index (0 - 127).
+ * @param  count       Number of words to read (index + count must not exceed V280_BUFFER_SIZE).
+ * @param  values      Storage for count values.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_read_buffer_range(
+  V120_HANDLE* restrict hV120, 
+  VME_REGION* restrict v280_region, 
+  uint8_t index, 
+  size_t count, 
+  uint16_t* restrict values
+);
+
+/**
+ * Writes a range of the buffer as one block of consecutive bus writes.
+ * 
+ * @param  v280_region VME region of the V280 module.
+ * @param  index       First buffer index (0 - 127).
+ * @param  count       Number of words to write (index + count must not exceed V280_BUFFER_SIZE).
+ * @param  values      Values to write.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_write_buffer_range(
+  VME_REGION* restrict v280_region, 
+  uint8_t index, 
+  size_t count, 
+  const uint16_t* restrict values
+);
+
 /***************************************************************************************************
  * V280 Macro Control
  **************************************************************************************************/
 
+/**
+ * Starts the Built-In Self Test (BIST) on the V280 module without waiting for it to complete.
+ * 
+ * @param  v280_region VME region of the V280 module.
+ * @return 0 on success, -1 on failure or if the macro is busy.
+ */
+int v280_start_bist(VME_REGION* restrict v280_region);
+
+/**
+ * Checks whether a BIST started with v280_start_bist() has completed.
+ * 
+ * @param  v280_region VME region of the V280 module.
+ * @param  done        Pointer to store whether the BIST has completed.
+ * @return 0 on success, -1 on failure, -2 if the BIST completed with an error.
+ */
+int v280_poll_bist(VME_REGION* restrict v280_region, bool* restrict done);
+
+/**
+ * Reads the BIST error flags of all channels with a single DMA transfer.
+ * 
+ * @param  hV120       Handle to the V120 library.
+ * @param  v280_region VME region of the V280 module.
+ * @param  error_flags Pointer to store the 48-bit value representing the BIST 
+ *                     error flags of all channels.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_collect_bist(
+  V120_HANDLE* restrict hV120, 
+  VME_REGION* restrict v280_region, 
+  uint64_t* restrict error_flags
+);
+
 /**
  * Runs the Built-In Self Test (BIST) on the V280 module.
  * 
  * @param  v280_region VME region of the V280 module.
- * @return 0 on success, -1 if macro busy, -2 if there was a BIST error.
+ * @return 0 on success, -1 if macro busy, -2 if there was a BIST error, 
+ *         -3 if the BIST did not complete within V280_BIST_TIMEOUT_US.
  */
 int v280_run_bist(VME_REGION* restrict v280_region);
+
+/**
+ * Runs the BIST on several V280 modules concurrently. Every module is started before any is
+ * polled, the modules are then polled round-robin with an increasing delay between passes, and
+ * the error flags of each module are collected with one DMA transfer as soon as it completes.
+ * 
+ * @param  hV120        Handle to the V120 library.
+ * @param  regions      VME regions of the V280 modules.
+ * @param  module_count Number of modules.
+ * @param  timeout_us   Maximum time to wait for all modules to complete.
+ * @param  results      Storage for the result of each module.
+ * @return 0 if every module passed, -1 on invalid arguments, -2 otherwise (see results).
+ */
+int v280_run_bist_all(
+  V120_HANDLE* restrict hV120, 
+  VME_REGION* const* restrict regions, 
+  size_t module_count, 
+  uint32_t timeout_us, 
+  v280_bist_result_t* restrict results
+);
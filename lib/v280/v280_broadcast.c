@@ -0,0 +1,358 @@
+/**
+ * Implementation of the V280 Broadcast Ring.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "v280_broadcast.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define V280_CHANNEL_MASK ((1ULL << V280_CHANNEL_COUNT) - 1)
+
+/** Broadcast ring magic ("V28B"). */
+#define V280_BROADCAST_MAGIC 0x42383256
+
+#define V280_BROADCAST_VERSION 1
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/**
+ * One entry of the ring. Entry n lives in slot (n & mask); seq is 2n + 1 while the producer
+ * writes it and 2n + 2 once it is complete. The payload is accessed with relaxed atomics so that
+ * a reader racing the producer is well defined, and discards what it read if seq changed.
+ */
+typedef struct v280_broadcast_slot_t {
+  _Atomic uint64_t seq;
+  _Atomic uint64_t timestamp_ns;
+  _Atomic uint64_t states;
+  _Atomic uint64_t changed;
+  _Atomic uint32_t module;
+  uint32_t reserved;
+} v280_broadcast_slot_t;
+
+/** Layout of the shared memory. */
+typedef struct v280_broadcast_file_t {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t slot_size;
+  uint64_t capacity;
+  /** Number of entries published; on its own cache line, as every reader polls it. */
+  _Alignas(64) _Atomic uint64_t head;
+  _Alignas(64) v280_broadcast_slot_t slots[];
+} v280_broadcast_file_t;
+
+/** Last states published for a module by v280_broadcast_poll(). */
+typedef struct v280_broadcast_module_t {
+  bool valid;
+  uint64_t states;
+} v280_broadcast_module_t;
+
+/** V280 Broadcast Ring mapping. */
+struct v280_broadcast_t {
+  v280_broadcast_file_t* file;
+  size_t size;
+  uint64_t mask;
+  bool producer;
+
+  /** Producer only. */
+  v280_broadcast_module_t* modules;
+  size_t module_count;
+};
+
+/** V280 Broadcast Reader. */
+struct v280_broadcast_reader_t {
+  v280_broadcast_t* ring;
+  /** Sequence number of the next entry to read. */
+  uint64_t cursor;
+  uint64_t lost;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+/**
+ * Gets the size of the shared memory for a capacity.
+ *
+ * @param  capacity Number of slots.
+ * @return Size in bytes.
+ */
+static inline size_t v280_broadcast_size(uint64_t capacity) {
+  return sizeof(v280_broadcast_file_t) + capacity * sizeof(v280_broadcast_slot_t);
+}
+
+/**
+ * Allocates the ring mapping for a mapped file.
+ *
+ * @param  file     Mapped file.
+ * @param  size     Size of the mapping.
+ * @param  producer Whether the mapping may publish.
+ * @return Pointer to the ring, or NULL on failure (the file is unmapped).
+ */
+static v280_broadcast_t* v280_broadcast_alloc(v280_broadcast_file_t* file, size_t size,
+    bool producer) {
+  v280_broadcast_t* ring = malloc(sizeof(v280_broadcast_t));
+  if (ring == NULL) {
+    printf("v280_broadcast: Failed to allocate memory for ring\n");
+    munmap(file, size);
+    return NULL;
+  }
+  memset(ring, 0, sizeof(v280_broadcast_t));
+  ring->file = file;
+  ring->size = size;
+  ring->mask = file->capacity - 1;
+  ring->producer = producer;
+  return ring;
+}
+
+v280_broadcast_t* v280_broadcast_create(const char* restrict name, size_t capacity) {
+  if (name == NULL || capacity == 0) return NULL;
+
+  uint64_t slots = 1;
+  while (slots < capacity) slots <<= 1;
+  const size_t size = v280_broadcast_size(slots);
+
+  /** Never replace a ring that live readers may have mapped. */
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    if (errno == EEXIST) {
+      printf("v280_broadcast_create: %s already exists\n", name);
+    } else {
+      printf("v280_broadcast_create: Failed to open %s\n", name);
+    }
+    return NULL;
+  }
+  if (ftruncate(fd, (off_t)size) < 0) {
+    printf("v280_broadcast_create: Failed to size %s\n", name);
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+
+  v280_broadcast_file_t* file = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    printf("v280_broadcast_create: Failed to map %s\n", name);
+    shm_unlink(name);
+    return NULL;
+  }
+
+  /** ftruncate() zero-fills, so every slot starts with a sequence that matches no entry. */
+  file->version = V280_BROADCAST_VERSION;
+  file->slot_size = sizeof(v280_broadcast_slot_t);
+  file->capacity = slots;
+  atomic_store_explicit(&file->head, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  file->magic = V280_BROADCAST_MAGIC;
+
+  return v280_broadcast_alloc(file, size, true);
+}
+
+v280_broadcast_t* v280_broadcast_open(const char* restrict name) {
+  if (name == NULL) return NULL;
+
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    printf("v280_broadcast_open: Failed to open %s\n", name);
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(v280_broadcast_file_t)) {
+    printf("v280_broadcast_open: %s is not a broadcast ring\n", name);
+    close(fd);
+    return NULL;
+  }
+
+  const size_t size = (size_t)st.st_size;
+  v280_broadcast_file_t* file = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    printf("v280_broadcast_open: Failed to map %s\n", name);
+    return NULL;
+  }
+
+  /** The magic is written last, so the rest of the header is valid once it is seen. */
+  const bool has_magic = (file->magic == V280_BROADCAST_MAGIC);
+  atomic_thread_fence(memory_order_acquire);
+  const uint64_t capacity = file->capacity;
+  if (!has_magic || file->version != V280_BROADCAST_VERSION ||
+      file->slot_size != sizeof(v280_broadcast_slot_t) || capacity == 0 ||
+      (capacity & (capacity - 1)) != 0 || v280_broadcast_size(capacity) > size) {
+    printf("v280_broadcast_open: %s is not a broadcast ring\n", name);
+    munmap(file, size);
+    return NULL;
+  }
+
+  return v280_broadcast_alloc(file, size, false);
+}
+
+void v280_broadcast_close(v280_broadcast_t* restrict ring) {
+  if (ring == NULL) return;
+  munmap(ring->file, ring->size);
+  free(ring->modules);
+  free(ring);
+}
+
+int v280_broadcast_remove(const char* restrict name) {
+  if (name == NULL) return -1;
+  return (shm_unlink(name) == 0) ? 0 : -1;
+}
+
+int v280_broadcast_publish(v280_broadcast_t* restrict ring,
+    const v280_broadcast_entry_t* restrict entry) {
+  if (ring == NULL || entry == NULL || !ring->producer) return -1;
+  v280_broadcast_file_t* file = ring->file;
+
+  const uint64_t n = atomic_load_explicit(&file->head, memory_order_relaxed);
+  v280_broadcast_slot_t* slot = &file->slots[n & ring->mask];
+
+  /** Mark the slot as being written before any of its payload changes. */
+  atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&slot->timestamp_ns, entry->timestamp_ns, memory_order_relaxed);
+  atomic_store_explicit(&slot->states, entry->states & V280_CHANNEL_MASK, memory_order_relaxed);
+  atomic_store_explicit(&slot->changed, entry->changed & V280_CHANNEL_MASK, memory_order_relaxed);
+  atomic_store_explicit(&slot->module, entry->module, memory_order_relaxed);
+  atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+
+  atomic_store_explicit(&file->head, n + 1, memory_order_release);
+  return 0;
+}
+
+int v280_broadcast_poll(v280_broadcast_t* restrict ring, VME_REGION* restrict v280_region,
+    uint16_t module) {
+  if (ring == NULL || v280_region == NULL || !ring->producer) return -1;
+
+  if (module >= ring->module_count) {
+    const size_t count = (size_t)module + 1;
+    v280_broadcast_module_t* modules = realloc(ring->modules,
+        count * sizeof(v280_broadcast_module_t));
+    if (modules == NULL) {
+      printf("v280_broadcast_poll: Failed to allocate memory for module states\n");
+      return -1;
+    }
+    memset(&modules[ring->module_count], 0,
+        (count - ring->module_count) * sizeof(v280_broadcast_module_t));
+    ring->modules = modules;
+    ring->module_count = count;
+  }
+
+  uint64_t states;
+  int status = v280_get_input_states_stable(v280_region, V280_SNAPSHOT_DEFAULT_RETRIES, &states);
+  if (status != 0) return status;
+  const uint64_t timestamp_ns = v280_get_time_ns();
+  states &= V280_CHANNEL_MASK;
+
+  v280_broadcast_module_t* last = &ring->modules[module];
+  if (!last->valid) {
+    last->states = states;
+    last->valid = true;
+    return 0;
+  }
+  const uint64_t changed = states ^ last->states;
+  if (changed == 0) return 0;
+  last->states = states;
+
+  v280_broadcast_entry_t entry = {
+    .timestamp_ns = timestamp_ns,
+    .states = states,
+    .changed = changed,
+    .module = module,
+  };
+  status = v280_broadcast_publish(ring, &entry);
+  return (status == 0) ? 1 : status;
+}
+
+v280_broadcast_reader_t* v280_broadcast_subscribe(v280_broadcast_t* restrict ring) {
+  if (ring == NULL) return NULL;
+  v280_broadcast_reader_t* reader = malloc(sizeof(v280_broadcast_reader_t));
+  if (reader == NULL) {
+    printf("v280_broadcast_subscribe: Failed to allocate memory for reader\n");
+    return NULL;
+  }
+  reader->ring = ring;
+  reader->cursor = atomic_load_explicit(&ring->file->head, memory_order_acquire);
+  reader->lost = 0;
+  return reader;
+}
+
+void v280_broadcast_unsubscribe(v280_broadcast_reader_t* restrict reader) {
+  free(reader);
+}
+
+/**
+ * Moves an overrun reader to the oldest entry that is still in the ring and will not be
+ * overwritten by the next publish.
+ *
+ * @param  reader Reader.
+ * @param  head   Number of entries published.
+ * @return -3.
+ */
+static int v280_broadcast_resync(v280_broadcast_reader_t* restrict reader, uint64_t head) {
+  const uint64_t capacity = reader->ring->mask + 1;
+  const uint64_t oldest = (head > capacity) ? head - capacity + 1 : 0;
+  if (oldest > reader->cursor) {
+    reader->lost += oldest - reader->cursor;
+    reader->cursor = oldest;
+  }
+  return -3;
+}
+
+int v280_broadcast_read(v280_broadcast_reader_t* restrict reader,
+    v280_broadcast_entry_t* restrict entry) {
+  if (reader == NULL || entry == NULL) return -1;
+  v280_broadcast_file_t* file = reader->ring->file;
+
+  uint64_t head = atomic_load_explicit(&file->head, memory_order_acquire);
+  if (reader->cursor >= head) return -2;
+  if (head - reader->cursor > reader->ring->mask + 1) return v280_broadcast_resync(reader, head);
+
+  const uint64_t n = reader->cursor;
+  v280_broadcast_slot_t* slot = &file->slots[n & reader->ring->mask];
+  const uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+  if (seq == 2 * n + 2) {
+    entry->timestamp_ns = atomic_load_explicit(&slot->timestamp_ns, memory_order_relaxed);
+    entry->states = atomic_load_explicit(&slot->states, memory_order_relaxed);
+    entry->changed = atomic_load_explicit(&slot->changed, memory_order_relaxed);
+    entry->module = (uint16_t)atomic_load_explicit(&slot->module, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq) {
+      reader->cursor = n + 1;
+      return 0;
+    }
+  }
+
+  /** The producer lapped the reader between the head check and the copy. */
+  head = atomic_load_explicit(&file->head, memory_order_acquire);
+  return v280_broadcast_resync(reader, head);
+}
+
+int v280_broadcast_get_lost(const v280_broadcast_reader_t* restrict reader,
+    uint64_t* restrict lost) {
+  if (reader == NULL || lost == NULL) return -1;
+  *lost = reader->lost;
+  return 0;
+}
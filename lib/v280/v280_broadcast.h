@@ -0,0 +1,162 @@
+/**
+ * Public API for the V280 input broadcast ring.
+ *
+ * One producer publishes timestamped V280 state changes into a ring in POSIX shared memory, and
+ * any number of readers in any number of processes follow it, each with its own cursor. The
+ * producer never waits for readers: every slot carries a sequence number that the producer makes
+ * odd while writing and even when done, so a reader detects a slot that was overwritten before
+ * or while it was read, skips ahead to the oldest entry still in the ring and reports how many
+ * entries it lost.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+#include "v280.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V280 Broadcast Entry. */
+typedef struct v280_broadcast_entry_t {
+  uint64_t timestamp_ns;  /** Time of the sample that saw the change (CLOCK_MONOTONIC). */
+  uint64_t states;        /** 48-bit input states of the module after the change. */
+  uint64_t changed;       /** 48-bit mask of the channels that changed. */
+  uint16_t module;        /** Index of the module. */
+} v280_broadcast_entry_t;
+
+/** V280 Broadcast Ring mapping (opaque). */
+typedef struct v280_broadcast_t v280_broadcast_t;
+
+/** V280 Broadcast Reader (opaque). */
+typedef struct v280_broadcast_reader_t v280_broadcast_reader_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates the shared memory ring for the producer. Fails if a ring of the same name exists, so a
+ * second producer cannot take over a ring that readers have mapped; a stale ring left by a
+ * producer that exited must be removed with v280_broadcast_remove() first.
+ *
+ * @param  name     POSIX shared memory name (e.g. "/v280_inputs").
+ * @param  capacity Minimum number of entries the ring holds (rounded up to a power of 2).
+ * @return Pointer to the ring, or NULL on failure.
+ */
+v280_broadcast_t* v280_broadcast_create(const char* restrict name, size_t capacity);
+
+/**
+ * Opens an existing shared memory ring for reading.
+ *
+ * @param  name POSIX shared memory name.
+ * @return Pointer to the ring, or NULL on failure.
+ */
+v280_broadcast_t* v280_broadcast_open(const char* restrict name);
+
+/**
+ * Unmaps the ring. Readers created on it must be unsubscribed first. The shared memory remains
+ * until v280_broadcast_remove() is called.
+ *
+ * @param  ring Ring to close.
+ */
+void v280_broadcast_close(v280_broadcast_t* restrict ring);
+
+/**
+ * Removes the shared memory ring name. Mappings that are already open stay valid.
+ *
+ * @param  name POSIX shared memory name.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_broadcast_remove(const char* restrict name);
+
+/**
+ * Publishes an entry, overwriting the oldest entry once the ring is full. Only the process that
+ * created the ring may publish, from a single thread.
+ *
+ * @param  ring  Ring created with v280_broadcast_create().
+ * @param  entry Entry to publish.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_broadcast_publish(
+  v280_broadcast_t* restrict ring,
+  const v280_broadcast_entry_t* restrict entry
+);
+
+/**
+ * Reads a stable snapshot of the input states of a V280 module and publishes it, timestamped
+ * with the current CLOCK_MONOTONIC time, if it differs from the last states published for the
+ * module. The first poll of a module only establishes its reference states. Like
+ * v280_broadcast_publish(), only the creating process may call this, from a single thread.
+ *
+ * @param  ring        Ring created with v280_broadcast_create().
+ * @param  v280_region VME region of the V280 module.
+ * @param  module      Index of the module.
+ * @return 1 if a change was published, 0 if nothing changed, -1 on failure, -2 if the inputs did
+ *         not stabilize.
+ */
+int v280_broadcast_poll(
+  v280_broadcast_t* restrict ring,
+  VME_REGION* restrict v280_region,
+  uint16_t module
+);
+
+/**
+ * Creates a reader positioned after the newest entry, so it receives only later entries. Each
+ * reader must be used by a single thread.
+ *
+ * @param  ring Ring.
+ * @return Pointer to the reader, or NULL on failure.
+ */
+v280_broadcast_reader_t* v280_broadcast_subscribe(v280_broadcast_t* restrict ring);
+
+/**
+ * Deletes a reader.
+ *
+ * @param  reader Reader to delete.
+ */
+void v280_broadcast_unsubscribe(v280_broadcast_reader_t* restrict reader);
+
+/**
+ * Reads the next entry without blocking.
+ *
+ * @param  reader Reader.
+ * @param  entry  Storage for the entry.
+ * @return 0 if an entry was read, -1 on failure, -2 if no new entry is available, -3 if the
+ *         reader was overrun (its cursor has moved to the oldest entry still in the ring and the
+ *         skipped entries are added to its lost count).
+ */
+int v280_broadcast_read(
+  v280_broadcast_reader_t* restrict reader,
+  v280_broadcast_entry_t* restrict entry
+);
+
+/**
+ * Gets the number of entries a reader has lost to overruns.
+ *
+ * @param  reader Reader.
+ * @param  lost   Storage for the number of lost entries.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_broadcast_get_lost(
+  const v280_broadcast_reader_t* restrict reader,
+  uint64_t* restrict lost
+);
@@ -0,0 +1,306 @@
+/**
+ * Implementation of the V280 Change-of-State Event Engine.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "v280.h"
+#include "v280_events.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define V280_CHANNEL_MASK ((1ULL << V280_CHANNEL_COUNT) - 1)
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V280 Event Subscription. */
+struct v280_subscription_t {
+  uint64_t* channel_masks;
+  v280_event_t* queue;
+  size_t queue_mask;
+  /** Written only by the polling thread. */
+  atomic_size_t head;
+  /** Written only by the consumer. */
+  atomic_size_t tail;
+  atomic_uint_fast64_t dropped;
+};
+
+/** V280 Event Engine. */
+struct v280_events_t {
+  VME_REGION** regions;
+  uint64_t* states;
+  /** False until a module's reference states have been read. */
+  bool* has_states;
+  size_t module_count;
+  uint64_t poll_interval_ns;
+
+  v280_subscription_t** subscriptions;
+  size_t subscription_count;
+
+  pthread_t thread;
+  bool thread_active;
+  atomic_bool stop_requested;
+
+  atomic_uint_fast64_t polls;
+  atomic_uint_fast64_t events;
+  atomic_uint_fast64_t dropped;
+  atomic_uint_fast64_t errors;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+v280_events_t* v280_events_create(VME_REGION* const* restrict regions, size_t module_count,
+    uint32_t poll_interval_us) {
+  if (regions == NULL || module_count == 0) return NULL;
+
+  v280_events_t* engine = malloc(sizeof(v280_events_t));
+  if (engine == NULL) {
+    printf("v280_events_create: Failed to allocate memory for event engine\n");
+    return NULL;
+  }
+  memset(engine, 0, sizeof(v280_events_t));
+  atomic_init(&engine->stop_requested, false);
+  atomic_init(&engine->polls, 0);
+  atomic_init(&engine->events, 0);
+  atomic_init(&engine->dropped, 0);
+  atomic_init(&engine->errors, 0);
+
+  engine->module_count = module_count;
+  engine->poll_interval_ns = (uint64_t)poll_interval_us * 1000ULL;
+  engine->regions = malloc(module_count * sizeof(*engine->regions));
+  engine->states = malloc(module_count * sizeof(*engine->states));
+  engine->has_states = malloc(module_count * sizeof(*engine->has_states));
+  if (engine->regions == NULL || engine->states == NULL || engine->has_states == NULL) {
+    printf("v280_events_create: Failed to allocate memory for modules\n");
+    v280_events_delete(engine);
+    return NULL;
+  }
+  memcpy(engine->regions, regions, module_count * sizeof(*engine->regions));
+
+  return engine;
+}
+
+/**
+ * Deletes a subscription.
+ *
+ * @param  subscription Subscription to delete.
+ */
+static void v280_events_delete_subscription(v280_subscription_t* restrict subscription) {
+  if (subscription == NULL) return;
+  free(subscription->channel_masks);
+  free(subscription->queue);
+  free(subscription);
+}
+
+void v280_events_delete(v280_events_t* restrict engine) {
+  if (engine == NULL) return;
+  v280_events_stop(engine);
+  for (size_t i = 0; i < engine->subscription_count; i++) {
+    v280_events_delete_subscription(engine->subscriptions[i]);
+  }
+  free(engine->subscriptions);
+  free(engine->regions);
+  free(engine->states);
+  free(engine->has_states);
+  free(engine);
+}
+
+v280_subscription_t* v280_events_subscribe(v280_events_t* restrict engine,
+    const uint64_t* restrict channel_masks, size_t queue_capacity) {
+  if (engine == NULL || channel_masks == NULL || engine->thread_active) return NULL;
+
+  size_t capacity = 1;
+  while (capacity < queue_capacity) capacity <<= 1;
+
+  v280_subscription_t* subscription = malloc(sizeof(v280_subscription_t));
+  if (subscription == NULL) {
+    printf("v280_events_subscribe: Failed to allocate memory for subscription\n");
+    return NULL;
+  }
+  memset(subscription, 0, sizeof(v280_subscription_t));
+  atomic_init(&subscription->head, 0);
+  atomic_init(&subscription->tail, 0);
+  atomic_init(&subscription->dropped, 0);
+  subscription->queue_mask = capacity - 1;
+  subscription->queue = malloc(capacity * sizeof(*subscription->queue));
+  subscription->channel_masks = malloc(engine->module_count * sizeof(uint64_t));
+
+  v280_subscription_t** subscriptions = realloc(engine->subscriptions,
+      (engine->subscription_count + 1) * sizeof(*engine->subscriptions));
+  if (subscription->queue == NULL || subscription->channel_masks == NULL ||
+      subscriptions == NULL) {
+    printf("v280_events_subscribe: Failed to allocate memory for subscription queue\n");
+    if (subscriptions != NULL) engine->subscriptions = subscriptions;
+    v280_events_delete_subscription(subscription);
+    return NULL;
+  }
+
+  for (size_t module = 0; module < engine->module_count; module++) {
+    subscription->channel_masks[module] = channel_masks[module] & V280_CHANNEL_MASK;
+  }
+  engine->subscriptions = subscriptions;
+  engine->subscriptions[engine->subscription_count++] = subscription;
+  return subscription;
+}
+
+/**
+ * Pushes an event to every subscription that selects it.
+ *
+ * @param  engine Event engine.
+ * @param  event  Event to deliver.
+ */
+static void v280_events_publish(v280_events_t* restrict engine, const v280_event_t* restrict event) {
+  for (size_t i = 0; i < engine->subscription_count; i++) {
+    v280_subscription_t* subscription = engine->subscriptions[i];
+    if (((subscription->channel_masks[event->module] >> event->channel) & 0x1) == 0) continue;
+
+    size_t head = atomic_load_explicit(&subscription->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&subscription->tail, memory_order_acquire);
+    if (head - tail > subscription->queue_mask) {
+      atomic_fetch_add_explicit(&subscription->dropped, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&engine->dropped, 1, memory_order_relaxed);
+      continue;
+    }
+    subscription->queue[head & subscription->queue_mask] = *event;
+    atomic_store_explicit(&subscription->head, head + 1, memory_order_release);
+  }
+}
+
+/**
+ * Polls every module once and publishes an event for each changed channel.
+ *
+ * @param  engine Event engine.
+ */
+static void v280_events_poll(v280_events_t* restrict engine) {
+  for (size_t module = 0; module < engine->module_count; module++) {
+    uint64_t states;
+    if (v280_get_input_states_stable(engine->regions[module], V280_SNAPSHOT_DEFAULT_RETRIES,
+        &states) != 0) {
+      atomic_fetch_add_explicit(&engine->errors, 1, memory_order_relaxed);
+      continue;
+    }
+    /** A module whose first read failed takes its reference on its first successful read. */
+    if (!engine->has_states[module]) {
+      engine->states[module] = states;
+      engine->has_states[module] = true;
+      continue;
+    }
+    uint64_t changed = (states ^ engine->states[module]) & V280_CHANNEL_MASK;
+    engine->states[module] = states;
+    if (changed == 0) continue;
+
+    v280_event_t event = {
+      .timestamp_ns = v280_get_time_ns(),
+      .states = states,
+      .module = (uint16_t)module,
+    };
+    atomic_fetch_add_explicit(&engine->events, (uint64_t)__builtin_popcountll(changed),
+        memory_order_relaxed);
+    while (changed != 0) {
+      event.channel = (uint8_t)__builtin_ctzll(changed);
+      changed &= changed - 1;
+      event.edge = ((states >> event.channel) & 0x1) ? V280_EDGE_RISE : V280_EDGE_FALL;
+      v280_events_publish(engine, &event);
+    }
+  }
+  atomic_fetch_add_explicit(&engine->polls, 1, memory_order_relaxed);
+}
+
+/**
+ * Polling thread: polls all modules on an absolute-deadline schedule until stopped.
+ *
+ * @param  arg Event engine.
+ * @return NULL.
+ */
+static void* v280_events_run(void* arg) {
+  v280_events_t* engine = (v280_events_t*)arg;
+
+  /** The first read only establishes the reference states. */
+  for (size_t module = 0; module < engine->module_count; module++) {
+    engine->has_states[module] = v280_get_input_states_stable(engine->regions[module],
+        V280_SNAPSHOT_DEFAULT_RETRIES, &engine->states[module]) == 0;
+  }
+
+  uint64_t deadline_ns = v280_get_time_ns();
+  while (!atomic_load_explicit(&engine->stop_requested, memory_order_relaxed)) {
+    if (engine->poll_interval_ns != 0) {
+      /** After an overrun, resume the schedule from now rather than polling back to back. */
+      uint64_t now_ns = v280_get_time_ns();
+      deadline_ns += engine->poll_interval_ns;
+      if (deadline_ns < now_ns) deadline_ns = now_ns;
+      struct timespec deadline = {
+        .tv_sec = (time_t)(deadline_ns / 1000000000ULL),
+        .tv_nsec = (long)(deadline_ns % 1000000000ULL),
+      };
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+    }
+    v280_events_poll(engine);
+  }
+  return NULL;
+}
+
+int v280_events_start(v280_events_t* restrict engine) {
+  if (engine == NULL || engine->thread_active) return -1;
+  atomic_store(&engine->stop_requested, false);
+  if (pthread_create(&engine->thread, NULL, v280_events_run, engine) != 0) {
+    printf("v280_events_start: Failed to create polling thread\n");
+    return -1;
+  }
+  engine->thread_active = true;
+  return 0;
+}
+
+int v280_events_stop(v280_events_t* restrict engine) {
+  if (engine == NULL) return -1;
+  if (!engine->thread_active) return 0;
+  atomic_store(&engine->stop_requested, true);
+  if (pthread_join(engine->thread, NULL) != 0) return -1;
+  engine->thread_active = false;
+  return 0;
+}
+
+int v280_events_pop(v280_subscription_t* restrict subscription, v280_event_t* restrict event) {
+  if (subscription == NULL || event == NULL) return -1;
+  size_t tail = atomic_load_explicit(&subscription->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&subscription->head, memory_order_acquire);
+  if (tail == head) return -2;
+  *event = subscription->queue[tail & subscription->queue_mask];
+  atomic_store_explicit(&subscription->tail, tail + 1, memory_order_release);
+  return 0;
+}
+
+int v280_events_get_dropped(const v280_subscription_t* restrict subscription,
+    uint64_t* restrict dropped) {
+  if (subscription == NULL) return -1;
+  *dropped = atomic_load_explicit(&subscription->dropped, memory_order_relaxed);
+  return 0;
+}
+
+int v280_events_get_stats(const v280_events_t* restrict engine,
+    v280_events_stats_t* restrict stats) {
+  if (engine == NULL) return -1;
+  stats->polls = atomic_load_explicit(&engine->polls, memory_order_relaxed);
+  stats->events = atomic_load_explicit(&engine->events, memory_order_relaxed);
+  stats->dropped = atomic_load_explicit(&engine->dropped, memory_order_relaxed);
+  stats->errors = atomic_load_explicit(&engine->errors, memory_order_relaxed);
+  return 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * Public API for the V280 change-of-state event engine.
+ *
+ * One polling thread per crate reads the 48-bit input states of every V280 module at a fixed rate
+ * and XORs them with the previous states. Each changed channel becomes a timestamped rise or fall
+ * event, delivered to every subscription whose channel mask includes it. Each subscription has
+ * its own lock-free single-producer/single-consumer queue; when a queue is full the event is
+ * dropped and counted rather than blocking the polling thread.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V280 Input Edge. */
+typedef enum v280_edge_t {
+  V280_EDGE_FALL = 0,
+  V280_EDGE_RISE = 1,
+} v280_edge_t;
+
+/** V280 Input Event. */
+typedef struct v280_event_t {
+  uint64_t timestamp_ns;  /** Time of the poll that saw the change (CLOCK_MONOTONIC). */
+  uint64_t states;        /** 48-bit input states of the module after the change. */
+  uint16_t module;        /** Index of the module in the engine. */
+  uint8_t channel;        /** Channel number (0 - 47). */
+  uint8_t edge;           /** v280_edge_t of the change. */
+} v280_event_t;
+
+/** V280 Event Engine Statistics. */
+typedef struct v280_events_stats_t {
+  uint64_t polls;     /** Number of polling passes over all modules. */
+  uint64_t events;    /** Number of events detected. */
+  uint64_t dropped;   /** Number of events dropped over all subscriptions. */
+  uint64_t errors;    /** Number of failed or unstable module reads. */
+} v280_events_stats_t;
+
+/** V280 Event Engine (opaque). */
+typedef struct v280_events_t v280_events_t;
+
+/** V280 Event Subscription (opaque). */
+typedef struct v280_subscription_t v280_subscription_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates an event engine over the given V280 modules. The regions remain owned by the caller.
+ *
+ * @param  regions          VME regions of the V280 modules.
+ * @param  module_count     Number of modules.
+ * @param  poll_interval_us Polling period in microseconds (0 to poll continuously).
+ * @return Pointer to the engine, or NULL on failure.
+ */
+v280_events_t* v280_events_create(
+  VME_REGION* const* restrict regions,
+  size_t module_count,
+  uint32_t poll_interval_us
+);
+
+/**
+ * Stops the engine if it is running and deletes it along with all of its subscriptions.
+ *
+ * @param  engine Event engine to delete.
+ */
+void v280_events_delete(v280_events_t* restrict engine);
+
+/**
+ * Adds a subscription. Subscriptions can only be added while the engine is stopped.
+ *
+ * @param  engine         Event engine.
+ * @param  channel_masks  One 48-bit channel mask per module selecting the events to receive.
+ * @param  queue_capacity Minimum number of events the queue can hold (rounded up to a power of 2).
+ * @return Pointer to the subscription, or NULL on failure.
+ */
+v280_subscription_t* v280_events_subscribe(
+  v280_events_t* restrict engine,
+  const uint64_t* restrict channel_masks,
+  size_t queue_capacity
+);
+
+/**
+ * Starts the polling thread.
+ *
+ * @param  engine Event engine.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_events_start(v280_events_t* restrict engine);
+
+/**
+ * Stops the polling thread and waits for it to exit.
+ *
+ * @param  engine Event engine.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_events_stop(v280_events_t* restrict engine);
+
+/**
+ * Pops the oldest event from a subscription queue without blocking. Each subscription must be
+ * consumed by a single thread.
+ *
+ * @param  subscription Subscription.
+ * @param  event        Storage for the event.
+ * @return 0 if an event was popped, -1 on failure, -2 if the queue is empty.
+ */
+int v280_events_pop(v280_subscription_t* restrict subscription, v280_event_t* restrict event);
+
+/**
+ * Gets the number of events dropped from a subscription because its queue was full.
+ *
+ * @param  subscription Subscription.
+ * @param  dropped      Storage for the number of dropped events.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_events_get_dropped(
+  const v280_subscription_t* restrict subscription,
+  uint64_t* restrict dropped
+);
+
+/**
+ * Gets the statistics of the event engine.
+ *
+ * @param  engine Event engine.
+ * @param  stats  Storage for the statistics.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_events_get_stats(const v280_events_t* restrict engine, v280_events_stats_t* restrict stats);
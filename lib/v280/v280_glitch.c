@@ -0,0 +1,235 @@
+/**
+ * Implementation of the V280 Glitch Monitor.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "v280_glitch.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define V280_CHANNEL_MASK ((1ULL << V280_CHANNEL_COUNT) - 1)
+
+/** Number of bit planes per vertical counter. */
+#define V280_GLITCH_PLANES 8
+
+/** Samples between folds, so that no vertical counter can overflow. */
+#define V280_GLITCH_FOLD_INTERVAL ((1U << V280_GLITCH_PLANES) - 1)
+
+#define V280_GLITCH_RATE_WINDOW_NS 1000000000ULL
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** 48 Bit-Sliced Counters: bit c of plane[k] is bit k of channel c's count. */
+typedef struct v280_glitch_counter_t {
+  uint64_t plane[V280_GLITCH_PLANES];
+} v280_glitch_counter_t;
+
+/** V280 Glitch Monitor. */
+struct v280_glitch_t {
+  /** Guards everything below. */
+  pthread_mutex_t lock;
+
+  uint8_t short_samples;
+  /** State, cleared by v280_glitch_reset(). */
+  bool has_reference;
+  uint64_t states;
+  uint64_t samples;
+  uint64_t timestamp_ns;
+
+  /** Changed channels of the most recent samples, newest at recent_head. */
+  uint64_t recent_changes[V280_GLITCH_MAX_SHORT_SAMPLES];
+  uint8_t recent_head;
+
+  v280_glitch_counter_t transitions;
+  v280_glitch_counter_t short_pulses;
+  v280_glitch_counter_t window;
+  uint32_t samples_since_fold;
+
+  uint64_t transition_totals[V280_CHANNEL_COUNT];
+  uint64_t short_pulse_totals[V280_CHANNEL_COUNT];
+  uint64_t window_totals[V280_CHANNEL_COUNT];
+  uint64_t max_rate[V280_CHANNEL_COUNT];
+  uint64_t window_start_ns;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+/**
+ * Adds one to the count of every channel in a mask, as a ripple-carry add across the planes.
+ *
+ * @param  counter Vertical counter.
+ * @param  mask    Channels to increment.
+ */
+static inline void v280_glitch_increment(v280_glitch_counter_t* restrict counter, uint64_t mask) {
+  uint64_t carry = mask;
+  for (uint8_t k = 0; k < V280_GLITCH_PLANES; k++) {
+    const uint64_t next = counter->plane[k] & carry;
+    counter->plane[k] ^= carry;
+    carry = next;
+  }
+}
+
+/**
+ * Gets the count of one channel from a vertical counter.
+ *
+ * @param  counter Vertical counter.
+ * @param  channel Channel number (0 - 47).
+ * @return Count of the channel.
+ */
+static inline uint32_t v280_glitch_count(const v280_glitch_counter_t* restrict counter,
+    uint8_t channel) {
+  uint32_t count = 0;
+  for (uint8_t k = 0; k < V280_GLITCH_PLANES; k++) {
+    count |= (uint32_t)((counter->plane[k] >> channel) & 0x1) << k;
+  }
+  return count;
+}
+
+/**
+ * Adds the counts of a vertical counter to per-channel totals and clears it.
+ *
+ * @param  counter Vertical counter.
+ * @param  totals  Per-channel totals.
+ */
+static void v280_glitch_fold(v280_glitch_counter_t* restrict counter, uint64_t* restrict totals) {
+  for (uint8_t channel = 0; channel < V280_CHANNEL_COUNT; channel++) {
+    totals[channel] += v280_glitch_count(counter, channel);
+  }
+  memset(counter, 0, sizeof(v280_glitch_counter_t));
+}
+
+/**
+ * Saturates a count to 32 bits.
+ *
+ * @param  count Count.
+ * @return Count, or UINT32_MAX if it does not fit.
+ */
+static inline uint32_t v280_glitch_saturate(uint64_t count) {
+  return (count > UINT32_MAX) ? UINT32_MAX : (uint32_t)count;
+}
+
+v280_glitch_t* v280_glitch_create(uint8_t short_samples) {
+  if (short_samples == 0 || short_samples > V280_GLITCH_MAX_SHORT_SAMPLES) return NULL;
+
+  v280_glitch_t* glitch = malloc(sizeof(v280_glitch_t));
+  if (glitch == NULL) {
+    printf("v280_glitch_create: Failed to allocate memory for glitch monitor\n");
+    return NULL;
+  }
+  memset(glitch, 0, sizeof(v280_glitch_t));
+  pthread_mutex_init(&glitch->lock, NULL);
+  glitch->short_samples = short_samples;
+  return glitch;
+}
+
+void v280_glitch_delete(v280_glitch_t* restrict glitch) {
+  if (glitch == NULL) return;
+  pthread_mutex_destroy(&glitch->lock);
+  free(glitch);
+}
+
+int v280_glitch_process(v280_glitch_t* restrict glitch, uint64_t states, uint64_t timestamp_ns) {
+  if (glitch == NULL) return -1;
+  states &= V280_CHANNEL_MASK;
+
+  pthread_mutex_lock(&glitch->lock);
+  glitch->samples++;
+  glitch->timestamp_ns = timestamp_ns;
+  if (!glitch->has_reference) {
+    glitch->states = states;
+    glitch->window_start_ns = timestamp_ns;
+    glitch->has_reference = true;
+    pthread_mutex_unlock(&glitch->lock);
+    return 0;
+  }
+
+  const uint64_t changed = states ^ glitch->states;
+  glitch->states = states;
+
+  /** A change that undoes a change from the last few samples ends a short pulse. */
+  uint64_t recent = 0;
+  for (uint8_t i = 0; i < glitch->short_samples; i++) recent |= glitch->recent_changes[i];
+  glitch->recent_head = (uint8_t)((glitch->recent_head + 1) % glitch->short_samples);
+  glitch->recent_changes[glitch->recent_head] = changed;
+
+  /** Close the rate window once a second; the cost is amortized over the samples in it. */
+  if (timestamp_ns - glitch->window_start_ns >= V280_GLITCH_RATE_WINDOW_NS) {
+    v280_glitch_fold(&glitch->window, glitch->window_totals);
+    for (uint8_t channel = 0; channel < V280_CHANNEL_COUNT; channel++) {
+      if (glitch->window_totals[channel] > glitch->max_rate[channel]) {
+        glitch->max_rate[channel] = glitch->window_totals[channel];
+      }
+      glitch->window_totals[channel] = 0;
+    }
+    glitch->window_start_ns = timestamp_ns;
+  }
+
+  v280_glitch_increment(&glitch->transitions, changed);
+  v280_glitch_increment(&glitch->short_pulses, changed & recent);
+  v280_glitch_increment(&glitch->window, changed);
+
+  if (++glitch->samples_since_fold == V280_GLITCH_FOLD_INTERVAL) {
+    v280_glitch_fold(&glitch->transitions, glitch->transition_totals);
+    v280_glitch_fold(&glitch->short_pulses, glitch->short_pulse_totals);
+    v280_glitch_fold(&glitch->window, glitch->window_totals);
+    glitch->samples_since_fold = 0;
+  }
+  pthread_mutex_unlock(&glitch->lock);
+  return 0;
+}
+
+int v280_glitch_poll(v280_glitch_t* restrict glitch, VME_REGION* restrict v280_region) {
+  if (glitch == NULL || v280_region == NULL) return -1;
+  uint64_t states;
+  int status = v280_get_input_states_stable(v280_region, V280_SNAPSHOT_DEFAULT_RETRIES, &states);
+  if (status != 0) return status;
+  return v280_glitch_process(glitch, states, v280_get_time_ns());
+}
+
+int v280_glitch_get_snapshot(v280_glitch_t* restrict glitch,
+    v280_glitch_snapshot_t* restrict snapshot) {
+  if (glitch == NULL || snapshot == NULL) return -1;
+  pthread_mutex_lock(&glitch->lock);
+  snapshot->samples = glitch->samples;
+  snapshot->timestamp_ns = glitch->timestamp_ns;
+  for (uint8_t channel = 0; channel < V280_CHANNEL_COUNT; channel++) {
+    snapshot->transitions[channel] = v280_glitch_saturate(glitch->transition_totals[channel] +
+        v280_glitch_count(&glitch->transitions, channel));
+    snapshot->short_pulses[channel] = v280_glitch_saturate(glitch->short_pulse_totals[channel] +
+        v280_glitch_count(&glitch->short_pulses, channel));
+    /** The open window is a lower bound on a full one, so it counts toward the maximum. */
+    uint64_t window = glitch->window_totals[channel] + v280_glitch_count(&glitch->window, channel);
+    uint64_t max_rate = glitch->max_rate[channel];
+    snapshot->max_rate[channel] = v280_glitch_saturate((window > max_rate) ? window : max_rate);
+  }
+  pthread_mutex_unlock(&glitch->lock);
+  return 0;
+}
+
+int v280_glitch_reset(v280_glitch_t* restrict glitch) {
+  if (glitch == NULL) return -1;
+  pthread_mutex_lock(&glitch->lock);
+  /** Everything after the configuration is state. */
+  const size_t offset = offsetof(v280_glitch_t, has_reference);
+  memset((char *)glitch + offset, 0, sizeof(v280_glitch_t) - offset);
+  pthread_mutex_unlock(&glitch->lock);
+  return 0;
+}
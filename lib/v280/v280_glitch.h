@@ -0,0 +1,113 @@
+/**
+ * Public API for V280 glitch and bounce instrumentation.
+ *
+ * A glitch monitor is fed successive 48-bit input state samples and keeps, for every channel, the
+ * number of transitions, the number of very short pulses and the highest number of transitions
+ * seen within one second. The counts are kept as bit-sliced (vertical) counters: bit c of plane k
+ * holds bit k of channel c's count, so one sample updates all 48 channels with a fixed number of
+ * bitwise operations whatever the input activity. The planes are folded into per-channel totals
+ * at a fixed interval.
+ *
+ * The monitor is written by one thread; snapshots can be taken from any thread.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+#include "v280.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Maximum length, in samples, of a pulse counted as short. */
+#define V280_GLITCH_MAX_SHORT_SAMPLES 16
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V280 Glitch Counter Snapshot. Counts saturate at UINT32_MAX. */
+typedef struct v280_glitch_snapshot_t {
+  uint64_t samples;                           /** Number of samples processed. */
+  uint64_t timestamp_ns;                      /** Timestamp of the last sample. */
+  uint32_t transitions[V280_CHANNEL_COUNT];   /** Transitions per channel. */
+  uint32_t short_pulses[V280_CHANNEL_COUNT];  /** Pulses no longer than the short pulse length. */
+  uint32_t max_rate[V280_CHANNEL_COUNT];      /** Most transitions within one second. */
+} v280_glitch_snapshot_t;
+
+/** V280 Glitch Monitor (opaque). */
+typedef struct v280_glitch_t v280_glitch_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates a glitch monitor with all counts at zero.
+ *
+ * @param  short_samples A pulse is short if the channel changes back within this many samples
+ *                       (1 - V280_GLITCH_MAX_SHORT_SAMPLES).
+ * @return Pointer to the glitch monitor, or NULL on failure.
+ */
+v280_glitch_t* v280_glitch_create(uint8_t short_samples);
+
+/**
+ * Deletes a glitch monitor.
+ *
+ * @param  glitch Glitch monitor to delete.
+ */
+void v280_glitch_delete(v280_glitch_t* restrict glitch);
+
+/**
+ * Processes one input state sample. The first sample only establishes the reference states.
+ *
+ * @param  glitch       Glitch monitor.
+ * @param  states       48-bit input states.
+ * @param  timestamp_ns Time of the sample in nanoseconds, non-decreasing between samples.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_glitch_process(v280_glitch_t* restrict glitch, uint64_t states, uint64_t timestamp_ns);
+
+/**
+ * Reads a stable snapshot of the input states of a V280 module and processes it with the current
+ * CLOCK_MONOTONIC time.
+ *
+ * @param  glitch      Glitch monitor.
+ * @param  v280_region VME region of the V280 module.
+ * @return 0 on success, -1 on failure, -2 if the inputs did not stabilize (no sample processed).
+ */
+int v280_glitch_poll(v280_glitch_t* restrict glitch, VME_REGION* restrict v280_region);
+
+/**
+ * Gets the counts of all channels.
+ *
+ * @param  glitch   Glitch monitor.
+ * @param  snapshot Storage for the snapshot.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_glitch_get_snapshot(
+  v280_glitch_t* restrict glitch,
+  v280_glitch_snapshot_t* restrict snapshot
+);
+
+/**
+ * Resets all counts.
+ *
+ * @param  glitch Glitch monitor.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_glitch_reset(v280_glitch_t* restrict glitch);
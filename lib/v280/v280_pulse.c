@@ -0,0 +1,344 @@
+/**
+ * Implementation of the V280 Pulse Counter.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "v280_pulse.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define V280_CHANNEL_MASK ((1ULL << V280_CHANNEL_COUNT) - 1)
+
+#define V280_PULSE_CHANNELS_PER_GROUP 16
+
+/** Number of bit planes per vertical counter. */
+#define V280_PULSE_PLANES 8
+
+/** Samples between folds, so that no vertical counter can overflow. */
+#define V280_PULSE_FOLD_INTERVAL ((1U << V280_PULSE_PLANES) - 1)
+
+/** The period estimate moves 1/8 of the way toward each new rising-edge interval. */
+#define V280_PULSE_PERIOD_WEIGHT 8
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** 48 Bit-Sliced Counters: bit c of plane[k] is bit k of channel c's count. */
+typedef struct v280_pulse_counter_t {
+  atomic_uint_fast64_t plane[V280_PULSE_PLANES];
+} v280_pulse_counter_t;
+
+/**
+ * V280 Pulse Counter. All shared values are atomics written only by the processing thread, and
+ * sequence is odd while a sample is being applied so readers can take consistent snapshots.
+ */
+struct v280_pulse_t {
+  atomic_uint_fast64_t sequence;
+  atomic_uint_fast64_t samples;
+  atomic_uint_fast64_t timestamp_ns;
+  /** Edge counts since the last fold; a channel's count is its total plus its vertical count. */
+  v280_pulse_counter_t rising;
+  v280_pulse_counter_t falling;
+  atomic_uint_fast64_t rising_totals[V280_CHANNEL_COUNT];
+  atomic_uint_fast64_t falling_totals[V280_CHANNEL_COUNT];
+  atomic_uint_fast64_t group_rising[V280_PULSE_GROUP_COUNT];
+  atomic_uint_fast64_t group_falling[V280_PULSE_GROUP_COUNT];
+  atomic_uint_fast64_t last_rise_ns[V280_CHANNEL_COUNT];
+  atomic_uint_fast64_t period_ns[V280_CHANNEL_COUNT];
+
+  /** Processing thread only. */
+  uint64_t states;
+  bool has_reference;
+  /** Channels with at least one rising edge, whose last_rise_ns is valid. */
+  uint64_t rise_seen;
+  uint32_t samples_since_fold;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+/**
+ * Loads a counter.
+ *
+ * @param  counter Counter.
+ * @return Counter value.
+ */
+static inline uint64_t v280_pulse_load(const atomic_uint_fast64_t* restrict counter) {
+  return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+/**
+ * Stores a counter. Only the processing thread writes, so no read-modify-write is needed.
+ *
+ * @param  counter Counter.
+ * @param  value   New value.
+ */
+static inline void v280_pulse_store(atomic_uint_fast64_t* restrict counter, uint64_t value) {
+  atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+/**
+ * Adds to a counter from the processing thread.
+ *
+ * @param  counter Counter.
+ * @param  value   Value to add.
+ */
+static inline void v280_pulse_add(atomic_uint_fast64_t* restrict counter, uint64_t value) {
+  v280_pulse_store(counter, v280_pulse_load(counter) + value);
+}
+
+/**
+ * Adds one to the count of every channel in a mask, as a ripple-carry add across the planes.
+ *
+ * @param  counter Vertical counter.
+ * @param  mask    Channels to increment.
+ */
+static inline void v280_pulse_increment(v280_pulse_counter_t* restrict counter, uint64_t mask) {
+  uint64_t carry = mask;
+  for (uint8_t k = 0; k < V280_PULSE_PLANES && carry != 0; k++) {
+    const uint64_t plane = v280_pulse_load(&counter->plane[k]);
+    v280_pulse_store(&counter->plane[k], plane ^ carry);
+    carry &= plane;
+  }
+}
+
+/**
+ * Gets the count of one channel, its folded total plus its vertical count.
+ *
+ * @param  counter Vertical counter.
+ * @param  totals  Per-channel totals.
+ * @param  channel Channel number (0 - 47).
+ * @return Count of the channel.
+ */
+static inline uint64_t v280_pulse_count(const v280_pulse_counter_t* restrict counter,
+    const atomic_uint_fast64_t* restrict totals, uint8_t channel) {
+  uint64_t count = 0;
+  for (uint8_t k = 0; k < V280_PULSE_PLANES; k++) {
+    count |= ((v280_pulse_load(&counter->plane[k]) >> channel) & 0x1) << k;
+  }
+  return v280_pulse_load(&totals[channel]) + count;
+}
+
+/**
+ * Adds the counts of a vertical counter to per-channel totals and clears it.
+ *
+ * @param  counter Vertical counter.
+ * @param  totals  Per-channel totals.
+ */
+static void v280_pulse_fold(v280_pulse_counter_t* restrict counter,
+    atomic_uint_fast64_t* restrict totals) {
+  for (uint8_t channel = 0; channel < V280_CHANNEL_COUNT; channel++) {
+    v280_pulse_store(&totals[channel], v280_pulse_count(counter, totals, channel));
+  }
+  for (uint8_t k = 0; k < V280_PULSE_PLANES; k++) v280_pulse_store(&counter->plane[k], 0);
+}
+
+/**
+ * Marks the start of an update for readers.
+ *
+ * @param  pulse Pulse counter.
+ */
+static inline void v280_pulse_write_begin(v280_pulse_t* restrict pulse) {
+  v280_pulse_store(&pulse->sequence, v280_pulse_load(&pulse->sequence) + 1);
+  atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Marks the end of an update for readers.
+ *
+ * @param  pulse Pulse counter.
+ */
+static inline void v280_pulse_write_end(v280_pulse_t* restrict pulse) {
+  atomic_store_explicit(&pulse->sequence, v280_pulse_load(&pulse->sequence) + 1,
+      memory_order_release);
+}
+
+/**
+ * Waits until no update is in progress and returns the sequence to validate a read against.
+ *
+ * @param  pulse Pulse counter.
+ * @return Sequence number.
+ */
+static inline uint64_t v280_pulse_read_begin(v280_pulse_t* restrict pulse) {
+  uint64_t sequence;
+  while ((sequence = atomic_load_explicit(&pulse->sequence, memory_order_acquire)) & 0x1);
+  return sequence;
+}
+
+/**
+ * Checks whether a read overlapped an update.
+ *
+ * @param  pulse    Pulse counter.
+ * @param  sequence Sequence returned by v280_pulse_read_begin().
+ * @return true if the read must be retried.
+ */
+static inline bool v280_pulse_read_retry(v280_pulse_t* restrict pulse, uint64_t sequence) {
+  atomic_thread_fence(memory_order_acquire);
+  return v280_pulse_load(&pulse->sequence) != sequence;
+}
+
+v280_pulse_t* v280_pulse_create(void) {
+  v280_pulse_t* pulse = malloc(sizeof(v280_pulse_t));
+  if (pulse == NULL) {
+    printf("v280_pulse_create: Failed to allocate memory for pulse counter\n");
+    return NULL;
+  }
+  memset(pulse, 0, sizeof(v280_pulse_t));
+  atomic_init(&pulse->sequence, 0);
+  return pulse;
+}
+
+void v280_pulse_delete(v280_pulse_t* restrict pulse) {
+  if (pulse != NULL) free(pulse);
+}
+
+int v280_pulse_process(v280_pulse_t* restrict pulse, uint64_t states, uint64_t timestamp_ns) {
+  if (pulse == NULL) return -1;
+  states &= V280_CHANNEL_MASK;
+
+  v280_pulse_write_begin(pulse);
+  v280_pulse_add(&pulse->samples, 1);
+  v280_pulse_store(&pulse->timestamp_ns, timestamp_ns);
+  if (!pulse->has_reference) {
+    pulse->states = states;
+    pulse->has_reference = true;
+    v280_pulse_write_end(pulse);
+    return 0;
+  }
+
+  const uint64_t changed = states ^ pulse->states;
+  const uint64_t rises = changed & states;
+  const uint64_t falls = changed & pulse->states;
+  pulse->states = states;
+
+  v280_pulse_increment(&pulse->rising, rises);
+  v280_pulse_increment(&pulse->falling, falls);
+  if (++pulse->samples_since_fold == V280_PULSE_FOLD_INTERVAL) {
+    v280_pulse_fold(&pulse->rising, pulse->rising_totals);
+    v280_pulse_fold(&pulse->falling, pulse->falling_totals);
+    pulse->samples_since_fold = 0;
+  }
+
+  if (changed != 0) {
+    for (uint8_t shift = 0; shift < V280_CHANNEL_COUNT; shift += V280_PULSE_CHANNELS_PER_GROUP) {
+      const uint8_t group = V280_DEBOUNCE_GROUP_OF_BIT(shift);
+      v280_pulse_add(&pulse->group_rising[group],
+          (uint64_t)__builtin_popcountll((rises >> shift) & 0xFFFF));
+      v280_pulse_add(&pulse->group_falling[group],
+          (uint64_t)__builtin_popcountll((falls >> shift) & 0xFFFF));
+    }
+
+    /** Each period estimate needs its own channel's interval, so only it visits channels. */
+    uint64_t pending = rises;
+    while (pending != 0) {
+      const uint8_t channel = (uint8_t)__builtin_ctzll(pending);
+      pending &= pending - 1;
+      if (pulse->rise_seen & (1ULL << channel)) {
+        int64_t interval = (int64_t)(timestamp_ns - v280_pulse_load(&pulse->last_rise_ns[channel]));
+        int64_t period = (int64_t)v280_pulse_load(&pulse->period_ns[channel]);
+        period = (period == 0) ? interval : period + (interval - period) / V280_PULSE_PERIOD_WEIGHT;
+        v280_pulse_store(&pulse->period_ns[channel], (uint64_t)period);
+      }
+      v280_pulse_store(&pulse->last_rise_ns[channel], timestamp_ns);
+    }
+    pulse->rise_seen |= rises;
+  }
+
+  v280_pulse_write_end(pulse);
+  return 0;
+}
+
+int v280_pulse_poll(v280_pulse_t* restrict pulse, VME_REGION* restrict v280_region) {
+  if (pulse == NULL || v280_region == NULL) return -1;
+  uint64_t states;
+  int status = v280_get_input_states_stable(v280_region, V280_SNAPSHOT_DEFAULT_RETRIES, &states);
+  if (status != 0) return status;
+  return v280_pulse_process(pulse, states, v280_get_time_ns());
+}
+
+int v280_pulse_get_channel(v280_pulse_t* restrict pulse, uint8_t channel,
+    v280_pulse_channel_t* restrict reading) {
+  if (pulse == NULL || reading == NULL) return -1;
+  if (channel >= V280_CHANNEL_COUNT) return -1;
+
+  uint64_t sequence, timestamp_ns, last_rise_ns;
+  do {
+    sequence = v280_pulse_read_begin(pulse);
+    reading->rising = v280_pulse_count(&pulse->rising, pulse->rising_totals, channel);
+    reading->falling = v280_pulse_count(&pulse->falling, pulse->falling_totals, channel);
+    reading->period_ns = v280_pulse_load(&pulse->period_ns[channel]);
+    last_rise_ns = v280_pulse_load(&pulse->last_rise_ns[channel]);
+    timestamp_ns = v280_pulse_load(&pulse->timestamp_ns);
+  } while (v280_pulse_read_retry(pulse, sequence));
+
+  /** Once no edge has arrived for longer than the period, the time since then bounds it. */
+  uint64_t period_ns = reading->period_ns;
+  if (period_ns != 0 && timestamp_ns - last_rise_ns > period_ns) {
+    period_ns = timestamp_ns - last_rise_ns;
+  }
+  reading->frequency_hz = (period_ns != 0) ? 1e9 / (double)period_ns : 0.0;
+  return 0;
+}
+
+int v280_pulse_get_snapshot(v280_pulse_t* restrict pulse,
+    v280_pulse_snapshot_t* restrict snapshot) {
+  if (pulse == NULL || snapshot == NULL) return -1;
+  uint64_t sequence;
+  do {
+    sequence = v280_pulse_read_begin(pulse);
+    snapshot->samples = v280_pulse_load(&pulse->samples);
+    snapshot->timestamp_ns = v280_pulse_load(&pulse->timestamp_ns);
+    for (uint8_t channel = 0; channel < V280_CHANNEL_COUNT; channel++) {
+      snapshot->rising[channel] = v280_pulse_count(&pulse->rising, pulse->rising_totals, channel);
+      snapshot->falling[channel] = v280_pulse_count(&pulse->falling, pulse->falling_totals,
+          channel);
+    }
+    for (uint8_t group = 0; group < V280_PULSE_GROUP_COUNT; group++) {
+      snapshot->group_rising[group] = v280_pulse_load(&pulse->group_rising[group]);
+      snapshot->group_falling[group] = v280_pulse_load(&pulse->group_falling[group]);
+    }
+  } while (v280_pulse_read_retry(pulse, sequence));
+  return 0;
+}
+
+int v280_pulse_reset(v280_pulse_t* restrict pulse) {
+  if (pulse == NULL) return -1;
+  v280_pulse_write_begin(pulse);
+  v280_pulse_store(&pulse->samples, 0);
+  v280_pulse_store(&pulse->timestamp_ns, 0);
+  for (uint8_t k = 0; k < V280_PULSE_PLANES; k++) {
+    v280_pulse_store(&pulse->rising.plane[k], 0);
+    v280_pulse_store(&pulse->falling.plane[k], 0);
+  }
+  for (uint8_t channel = 0; channel < V280_CHANNEL_COUNT; channel++) {
+    v280_pulse_store(&pulse->rising_totals[channel], 0);
+    v280_pulse_store(&pulse->falling_totals[channel], 0);
+    v280_pulse_store(&pulse->last_rise_ns[channel], 0);
+    v280_pulse_store(&pulse->period_ns[channel], 0);
+  }
+  for (uint8_t group = 0; group < V280_PULSE_GROUP_COUNT; group++) {
+    v280_pulse_store(&pulse->group_rising[group], 0);
+    v280_pulse_store(&pulse->group_falling[group], 0);
+  }
+  pulse->has_reference = false;
+  pulse->rise_seen = 0;
+  pulse->samples_since_fold = 0;
+  v280_pulse_write_end(pulse);
+  return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * Public API for V280 pulse counting and frequency estimation.
+ *
+ * A pulse counter is fed successive 48-bit input state samples. Each sample is processed for all
+ * channels at once: XOR with the previous sample gives the changed channels, AND with the new or
+ * previous sample splits them into rising and falling edges, and a popcount of each 16-channel
+ * group updates the group totals. Edge counts are bit-sliced (vertical) counters, as in the glitch
+ * monitor, so one sample updates all 48 counts with a fixed number of bitwise operations; only
+ * channels with a rising edge are visited to update their period estimate. Pulses shorter than
+ * the sampling interval are not seen.
+ *
+ * The counter is written by one thread; every value can be read from any other thread.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+#include "v280.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Number of 16-channel groups; group g holds the inputs of state[g]. */
+#define V280_PULSE_GROUP_COUNT V280_DEBOUNCE_GROUP_COUNT
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V280 Pulse Channel Reading. */
+typedef struct v280_pulse_channel_t {
+  uint64_t rising;        /** Number of rising edges. */
+  uint64_t falling;       /** Number of falling edges. */
+  uint64_t period_ns;     /** Smoothed rising-edge period (0 until two rising edges are seen). */
+  double frequency_hz;    /** Estimated frequency, decaying toward 0 once pulses stop. */
+} v280_pulse_channel_t;
+
+/** V280 Pulse Counter Snapshot, consistent across all channels. */
+typedef struct v280_pulse_snapshot_t {
+  uint64_t samples;                                 /** Number of samples processed. */
+  uint64_t timestamp_ns;                            /** Timestamp of the last sample. */
+  uint64_t rising[V280_CHANNEL_COUNT];              /** Rising edges per channel. */
+  uint64_t falling[V280_CHANNEL_COUNT];             /** Falling edges per channel. */
+  uint64_t group_rising[V280_PULSE_GROUP_COUNT];    /** Rising edges per 16-channel group. */
+  uint64_t group_falling[V280_PULSE_GROUP_COUNT];   /** Falling edges per 16-channel group. */
+} v280_pulse_snapshot_t;
+
+/** V280 Pulse Counter (opaque). */
+typedef struct v280_pulse_t v280_pulse_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates a pulse counter with all counts at zero.
+ *
+ * @return Pointer to the pulse counter, or NULL on failure.
+ */
+v280_pulse_t* v280_pulse_create(void);
+
+/**
+ * Deletes a pulse counter.
+ *
+ * @param  pulse Pulse counter to delete.
+ */
+void v280_pulse_delete(v280_pulse_t* restrict pulse);
+
+/**
+ * Processes one input state sample. The first sample only establishes the reference states.
+ *
+ * @param  pulse        Pulse counter.
+ * @param  states       48-bit input states.
+ * @param  timestamp_ns Time of the sample in nanoseconds, non-decreasing between samples.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_pulse_process(v280_pulse_t* restrict pulse, uint64_t states, uint64_t timestamp_ns);
+
+/**
+ * Reads a stable snapshot of the input states of a V280 module and processes it with the current
+ * CLOCK_MONOTONIC time.
+ *
+ * @param  pulse       Pulse counter.
+ * @param  v280_region VME region of the V280 module.
+ * @return 0 on success, -1 on failure, -2 if the inputs did not stabilize (no sample processed).
+ */
+int v280_pulse_poll(v280_pulse_t* restrict pulse, VME_REGION* restrict v280_region);
+
+/**
+ * Gets the counts and frequency estimate of one channel.
+ *
+ * @param  pulse   Pulse counter.
+ * @param  channel Channel number (0 - 47).
+ * @param  reading Storage for the channel reading.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_pulse_get_channel(
+  v280_pulse_t* restrict pulse,
+  uint8_t channel,
+  v280_pulse_channel_t* restrict reading
+);
+
+/**
+ * Gets the counts of all channels as of a single sample.
+ *
+ * @param  pulse    Pulse counter.
+ * @param  snapshot Storage for the snapshot.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_pulse_get_snapshot(v280_pulse_t* restrict pulse, v280_pulse_snapshot_t* restrict snapshot);
+
+/**
+ * Resets all counts and estimates. Must be called from the thread that processes samples.
+ *
+ * @param  pulse Pulse counter.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_pulse_reset(v280_pulse_t* restrict pulse);
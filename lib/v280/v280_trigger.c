@@ -0,0 +1,353 @@
+/**
+ * Implementation of the V280 Trigger Engine.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "v280.h"
+#include "v280_trigger.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define V280_CHANNEL_MASK ((1ULL << V280_CHANNEL_COUNT) - 1)
+
+/** Number of rules evaluated by one vector operation. */
+#define V280_TRIGGER_LANES 4
+
+/** Activation time of a rule whose condition does not hold. */
+#define V280_TRIGGER_INACTIVE UINT64_MAX
+
+/**
+ * Broadcasts a value to every lane. A macro rather than a function, because passing 32-byte
+ * vectors by value changes the ABI depending on whether AVX is enabled.
+ */
+#define V280_TRIGGER_BROADCAST(x) ((v280_trigger_vec_t){ (x), (x), (x), (x) })
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Four 64-bit lanes, evaluated with GCC vector extensions. */
+typedef uint64_t v280_trigger_vec_t __attribute__((vector_size(V280_TRIGGER_LANES * 8)));
+
+/**
+ * Compiled rules. Rules are sorted by module and each module's rules are padded to whole vectors
+ * with lanes that can never match (mask 0, value 1), so a module's state is broadcast once and
+ * compared against its rules a vector at a time.
+ */
+typedef struct v280_trigger_program_t {
+  v280_trigger_vec_t* mask;
+  v280_trigger_vec_t* value;
+  v280_trigger_vec_t* min_duration_ns;
+  /** Time the condition started to hold, or V280_TRIGGER_INACTIVE. */
+  v280_trigger_vec_t* since_ns;
+  /** All ones while the rule may fire. */
+  v280_trigger_vec_t* armed;
+  /** Rule identifier of each lane, -1 for padding. */
+  int32_t* rule_ids;
+  /** Vectors of module m are first_vector[m] to first_vector[m + 1] - 1. */
+  size_t* first_vector;
+  size_t vector_count;
+} v280_trigger_program_t;
+
+/** V280 Trigger Engine. */
+struct v280_trigger_t {
+  size_t module_count;
+
+  v280_trigger_rule_t* rules;
+  size_t rule_count;
+  bool compiled;
+  v280_trigger_program_t program;
+
+  v280_trigger_callback_t callback;
+  void* user_data;
+
+  v280_trigger_event_t* queue;
+  size_t queue_mask;
+  /** Written only by the processing thread. */
+  atomic_size_t head;
+  /** Written only by the consumer. */
+  atomic_size_t tail;
+  atomic_uint_fast64_t dropped;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+/**
+ * Frees the compiled rules.
+ *
+ * @param  program Compiled rules.
+ */
+static void v280_trigger_free_program(v280_trigger_program_t* restrict program) {
+  free(program->mask);
+  free(program->value);
+  free(program->min_duration_ns);
+  free(program->since_ns);
+  free(program->armed);
+  free(program->rule_ids);
+  free(program->first_vector);
+  memset(program, 0, sizeof(v280_trigger_program_t));
+}
+
+/**
+ * Allocates an aligned, zeroed array of vectors.
+ *
+ * @param  count Number of vectors.
+ * @return Pointer to the array, or NULL on failure.
+ */
+static v280_trigger_vec_t* v280_trigger_alloc_vectors(size_t count) {
+  size_t size = (count != 0 ? count : 1) * sizeof(v280_trigger_vec_t);
+  v280_trigger_vec_t* vectors = aligned_alloc(sizeof(v280_trigger_vec_t), size);
+  if (vectors != NULL) memset(vectors, 0, size);
+  return vectors;
+}
+
+/**
+ * Compiles the rules into vectors grouped by module, with every rule armed and inactive.
+ *
+ * @param  trigger Trigger engine.
+ * @return 0 on success, -1 on failure.
+ */
+static int v280_trigger_compile(v280_trigger_t* restrict trigger) {
+  v280_trigger_program_t* program = &trigger->program;
+  v280_trigger_free_program(program);
+
+  program->first_vector = malloc((trigger->module_count + 1) * sizeof(size_t));
+  if (program->first_vector == NULL) return -1;
+  size_t vector_count = 0;
+  for (size_t module = 0; module < trigger->module_count; module++) {
+    program->first_vector[module] = vector_count;
+    size_t rules = 0;
+    for (size_t i = 0; i < trigger->rule_count; i++) rules += (trigger->rules[i].module == module);
+    vector_count += (rules + V280_TRIGGER_LANES - 1) / V280_TRIGGER_LANES;
+  }
+  program->first_vector[trigger->module_count] = vector_count;
+  program->vector_count = vector_count;
+
+  program->mask = v280_trigger_alloc_vectors(vector_count);
+  program->value = v280_trigger_alloc_vectors(vector_count);
+  program->min_duration_ns = v280_trigger_alloc_vectors(vector_count);
+  program->since_ns = v280_trigger_alloc_vectors(vector_count);
+  program->armed = v280_trigger_alloc_vectors(vector_count);
+  program->rule_ids = malloc((vector_count * V280_TRIGGER_LANES + 1) * sizeof(int32_t));
+  if (program->mask == NULL || program->value == NULL || program->min_duration_ns == NULL ||
+      program->since_ns == NULL || program->armed == NULL || program->rule_ids == NULL) {
+    printf("v280_trigger_compile: Failed to allocate memory for compiled rules\n");
+    v280_trigger_free_program(program);
+    return -1;
+  }
+
+  for (size_t module = 0; module < trigger->module_count; module++) {
+    size_t lane = program->first_vector[module] * V280_TRIGGER_LANES;
+    const size_t end = program->first_vector[module + 1] * V280_TRIGGER_LANES;
+    for (size_t i = 0; i < trigger->rule_count; i++) {
+      const v280_trigger_rule_t* rule = &trigger->rules[i];
+      if (rule->module != module) continue;
+      const size_t v = lane / V280_TRIGGER_LANES, l = lane % V280_TRIGGER_LANES;
+      program->mask[v][l] = rule->high_mask | rule->low_mask;
+      program->value[v][l] = rule->high_mask;
+      program->min_duration_ns[v][l] = rule->min_duration_ns;
+      program->rule_ids[lane++] = (int32_t)i;
+    }
+    for (; lane < end; lane++) {
+      program->value[lane / V280_TRIGGER_LANES][lane % V280_TRIGGER_LANES] = 1;
+      program->rule_ids[lane] = -1;
+    }
+  }
+  for (size_t v = 0; v < vector_count; v++) {
+    program->since_ns[v] = V280_TRIGGER_BROADCAST(V280_TRIGGER_INACTIVE);
+    program->armed[v] = V280_TRIGGER_BROADCAST(UINT64_MAX);
+  }
+
+  trigger->compiled = true;
+  return 0;
+}
+
+v280_trigger_t* v280_trigger_create(size_t module_count, size_t queue_capacity) {
+  if (module_count == 0 || module_count > UINT16_MAX + 1UL) return NULL;
+
+  v280_trigger_t* trigger = malloc(sizeof(v280_trigger_t));
+  if (trigger == NULL) {
+    printf("v280_trigger_create: Failed to allocate memory for trigger engine\n");
+    return NULL;
+  }
+  memset(trigger, 0, sizeof(v280_trigger_t));
+  atomic_init(&trigger->head, 0);
+  atomic_init(&trigger->tail, 0);
+  atomic_init(&trigger->dropped, 0);
+  trigger->module_count = module_count;
+
+  if (queue_capacity != 0) {
+    size_t capacity = 1;
+    while (capacity < queue_capacity) capacity <<= 1;
+    trigger->queue = malloc(capacity * sizeof(*trigger->queue));
+    if (trigger->queue == NULL) {
+      printf("v280_trigger_create: Failed to allocate memory for event queue\n");
+      free(trigger);
+      return NULL;
+    }
+    trigger->queue_mask = capacity - 1;
+  }
+  return trigger;
+}
+
+void v280_trigger_delete(v280_trigger_t* restrict trigger) {
+  if (trigger == NULL) return;
+  v280_trigger_free_program(&trigger->program);
+  free(trigger->rules);
+  free(trigger->queue);
+  free(trigger);
+}
+
+int v280_trigger_add_rule(v280_trigger_t* restrict trigger,
+    const v280_trigger_rule_t* restrict rule) {
+  if (trigger == NULL || rule == NULL) return -1;
+  if (rule->module >= trigger->module_count) return -1;
+  if ((rule->high_mask & rule->low_mask) != 0) return -1;
+  if (((rule->high_mask | rule->low_mask) & ~V280_CHANNEL_MASK) != 0) return -1;
+  if (trigger->rule_count >= INT32_MAX) return -1;
+
+  v280_trigger_rule_t* rules = realloc(trigger->rules,
+      (trigger->rule_count + 1) * sizeof(v280_trigger_rule_t));
+  if (rules == NULL) {
+    printf("v280_trigger_add_rule: Failed to allocate memory for rule\n");
+    return -1;
+  }
+  trigger->rules = rules;
+  trigger->rules[trigger->rule_count] = *rule;
+  trigger->compiled = false;
+  return (int)trigger->rule_count++;
+}
+
+int v280_trigger_set_callback(v280_trigger_t* restrict trigger, v280_trigger_callback_t callback,
+    void* user_data) {
+  if (trigger == NULL) return -1;
+  trigger->callback = callback;
+  trigger->user_data = user_data;
+  return 0;
+}
+
+/**
+ * Reports a fired rule through the callback and the queue.
+ *
+ * @param  trigger Trigger engine.
+ * @param  event   Event to report.
+ */
+static void v280_trigger_emit(v280_trigger_t* restrict trigger,
+    const v280_trigger_event_t* restrict event) {
+  if (trigger->callback != NULL) trigger->callback(event, trigger->user_data);
+  if (trigger->queue == NULL) return;
+
+  size_t head = atomic_load_explicit(&trigger->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&trigger->tail, memory_order_acquire);
+  if (head - tail > trigger->queue_mask) {
+    atomic_fetch_add_explicit(&trigger->dropped, 1, memory_order_relaxed);
+    return;
+  }
+  trigger->queue[head & trigger->queue_mask] = *event;
+  atomic_store_explicit(&trigger->head, head + 1, memory_order_release);
+}
+
+/**
+ * Evaluates the compiled rules against one sample.
+ *
+ * @param  trigger      Trigger engine, compiled.
+ * @param  states       48-bit input states of each module.
+ * @param  timestamp_ns Time of the sample.
+ * @return Number of rules fired.
+ */
+static int v280_trigger_evaluate(v280_trigger_t* restrict trigger,
+    const uint64_t* restrict states, uint64_t timestamp_ns) {
+  v280_trigger_program_t* program = &trigger->program;
+  const v280_trigger_vec_t now = V280_TRIGGER_BROADCAST(timestamp_ns);
+  const v280_trigger_vec_t inactive = V280_TRIGGER_BROADCAST(V280_TRIGGER_INACTIVE);
+  int fired_count = 0;
+
+  for (size_t module = 0; module < trigger->module_count; module++) {
+    const v280_trigger_vec_t state = V280_TRIGGER_BROADCAST(states[module]);
+    for (size_t v = program->first_vector[module]; v < program->first_vector[module + 1]; v++) {
+      /** Vector comparisons yield all ones in lanes where they hold. */
+      const v280_trigger_vec_t match = (v280_trigger_vec_t)((state & program->mask[v]) ==
+          program->value[v]);
+      const v280_trigger_vec_t since = program->since_ns[v];
+      const v280_trigger_vec_t starting = (v280_trigger_vec_t)(since == inactive);
+      const v280_trigger_vec_t active_since = (starting & now) | (~starting & since);
+      const v280_trigger_vec_t next_since = (match & active_since) | (~match & inactive);
+      const v280_trigger_vec_t held = (v280_trigger_vec_t)((now - next_since) >=
+          program->min_duration_ns[v]);
+      const v280_trigger_vec_t fired = match & held & program->armed[v];
+      program->since_ns[v] = next_since;
+      program->armed[v] = (program->armed[v] & ~fired) | ~match;
+
+      if ((fired[0] | fired[1] | fired[2] | fired[3]) == 0) continue;
+      for (uint8_t lane = 0; lane < V280_TRIGGER_LANES; lane++) {
+        if (fired[lane] == 0) continue;
+        const v280_trigger_event_t event = {
+          .timestamp_ns = timestamp_ns,
+          .since_ns = next_since[lane],
+          .rule = (uint32_t)program->rule_ids[v * V280_TRIGGER_LANES + lane],
+          .module = (uint16_t)module,
+        };
+        v280_trigger_emit(trigger, &event);
+        fired_count++;
+      }
+    }
+  }
+  return fired_count;
+}
+
+int v280_trigger_process(v280_trigger_t* restrict trigger, const uint64_t* restrict states,
+    uint64_t timestamp_ns) {
+  if (trigger == NULL || states == NULL) return -1;
+  if (!trigger->compiled && v280_trigger_compile(trigger) < 0) return -1;
+  return v280_trigger_evaluate(trigger, states, timestamp_ns);
+}
+
+int v280_trigger_process_history(v280_trigger_t* restrict trigger, const uint64_t* restrict states,
+    const uint64_t* restrict timestamps_ns, size_t sample_count) {
+  if (trigger == NULL || states == NULL || timestamps_ns == NULL) return -1;
+  if (!trigger->compiled && v280_trigger_compile(trigger) < 0) return -1;
+  int fired_count = 0;
+  for (size_t sample = 0; sample < sample_count; sample++) {
+    fired_count += v280_trigger_evaluate(trigger, &states[sample * trigger->module_count],
+        timestamps_ns[sample]);
+  }
+  return fired_count;
+}
+
+int v280_trigger_reset(v280_trigger_t* restrict trigger) {
+  if (trigger == NULL) return -1;
+  trigger->compiled = false;
+  return 0;
+}
+
+int v280_trigger_pop(v280_trigger_t* restrict trigger, v280_trigger_event_t* restrict event) {
+  if (trigger == NULL || event == NULL || trigger->queue == NULL) return -1;
+  size_t tail = atomic_load_explicit(&trigger->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&trigger->head, memory_order_acquire);
+  if (tail == head) return -2;
+  *event = trigger->queue[tail & trigger->queue_mask];
+  atomic_store_explicit(&trigger->tail, tail + 1, memory_order_release);
+  return 0;
+}
+
+int v280_trigger_get_dropped(v280_trigger_t* restrict trigger, uint64_t* restrict dropped) {
+  if (trigger == NULL || dropped == NULL) return -1;
+  *dropped = atomic_load_explicit(&trigger->dropped, memory_order_relaxed);
+  return 0;
+}
@@ -0,0 +1,158 @@
+/**
+ * Public API for V280 pattern-match triggers.
+ *
+ * A trigger rule requires a set of inputs of one V280 module to be high, another set to be low,
+ * and both to hold for a minimum time. Rules are compiled into (mask, value, min-duration) tuples
+ * stored as structure-of-arrays and grouped by module, so each sample is evaluated several rules
+ * at a time with vector operations against the module's 48-bit state word. A rule fires once each
+ * time its condition has held for its minimum duration, and re-arms when the condition breaks.
+ * Fired rules are reported through a callback, a queue, or both.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V280 Trigger Rule. */
+typedef struct v280_trigger_rule_t {
+  uint16_t module;            /** Index of the module the rule applies to. */
+  uint64_t high_mask;         /** Channels that must be high. */
+  uint64_t low_mask;          /** Channels that must be low. */
+  uint64_t min_duration_ns;   /** Time the condition must hold before the rule fires. */
+} v280_trigger_rule_t;
+
+/** V280 Trigger Event. */
+typedef struct v280_trigger_event_t {
+  uint64_t timestamp_ns;      /** Time of the sample on which the rule fired. */
+  uint64_t since_ns;          /** Time of the first sample on which the condition held. */
+  uint32_t rule;              /** Rule identifier returned by v280_trigger_add_rule(). */
+  uint16_t module;            /** Index of the module. */
+} v280_trigger_event_t;
+
+/** Called on the processing thread for each fired rule. */
+typedef void (*v280_trigger_callback_t)(const v280_trigger_event_t* event, void* user_data);
+
+/** V280 Trigger Engine (opaque). */
+typedef struct v280_trigger_t v280_trigger_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates a trigger engine.
+ *
+ * @param  module_count   Number of modules in each sample.
+ * @param  queue_capacity Minimum number of events the queue can hold (rounded up to a power of 2),
+ *                        or 0 to report fired rules through the callback only.
+ * @return Pointer to the trigger engine, or NULL on failure.
+ */
+v280_trigger_t* v280_trigger_create(size_t module_count, size_t queue_capacity);
+
+/**
+ * Deletes a trigger engine.
+ *
+ * @param  trigger Trigger engine to delete.
+ */
+void v280_trigger_delete(v280_trigger_t* restrict trigger);
+
+/**
+ * Adds a rule. The rules are recompiled, and all activation states reset, on the next sample.
+ *
+ * @param  trigger Trigger engine.
+ * @param  rule    Rule to add (high_mask and low_mask must not overlap).
+ * @return Rule identifier (0, 1, ...) on success, -1 on failure.
+ */
+int v280_trigger_add_rule(
+  v280_trigger_t* restrict trigger,
+  const v280_trigger_rule_t* restrict rule
+);
+
+/**
+ * Sets the callback invoked for each fired rule.
+ *
+ * @param  trigger   Trigger engine.
+ * @param  callback  Callback, or NULL for none.
+ * @param  user_data Pointer passed to the callback.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_trigger_set_callback(
+  v280_trigger_t* restrict trigger,
+  v280_trigger_callback_t callback,
+  void* user_data
+);
+
+/**
+ * Evaluates all rules against one sample.
+ *
+ * @param  trigger      Trigger engine.
+ * @param  states       48-bit input states of each module.
+ * @param  timestamp_ns Time of the sample in nanoseconds, non-decreasing between samples.
+ * @return Number of rules fired, or -1 on failure.
+ */
+int v280_trigger_process(
+  v280_trigger_t* restrict trigger,
+  const uint64_t* restrict states,
+  uint64_t timestamp_ns
+);
+
+/**
+ * Evaluates all rules against a stored history of samples, in order.
+ *
+ * @param  trigger       Trigger engine.
+ * @param  states        Sample-major input states: sample_count rows of module_count states.
+ * @param  timestamps_ns Time of each sample.
+ * @param  sample_count  Number of samples.
+ * @return Number of rules fired, or -1 on failure.
+ */
+int v280_trigger_process_history(
+  v280_trigger_t* restrict trigger,
+  const uint64_t* restrict states,
+  const uint64_t* restrict timestamps_ns,
+  size_t sample_count
+);
+
+/**
+ * Re-arms all rules and forgets how long their conditions have held.
+ *
+ * @param  trigger Trigger engine.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_trigger_reset(v280_trigger_t* restrict trigger);
+
+/**
+ * Pops the oldest event from the queue without blocking. The queue must be consumed by a single
+ * thread.
+ *
+ * @param  trigger Trigger engine.
+ * @param  event   Storage for the event.
+ * @return 0 if an event was popped, -1 on failure, -2 if the queue is empty.
+ */
+int v280_trigger_pop(v280_trigger_t* restrict trigger, v280_trigger_event_t* restrict event);
+
+/**
+ * Gets the number of events dropped because the queue was full.
+ *
+ * @param  trigger Trigger engine.
+ * @param  dropped Storage for the number of dropped events.
+ * @return 0 on success, non-zero on failure.
+ */
+int v280_trigger_get_dropped(v280_trigger_t* restrict trigger, uint64_t* restrict dropped);
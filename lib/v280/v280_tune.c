@@ -0,0 +1,146 @@
+/**
+ * Implementation of the V280 Debounce Tuning.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "v280_tune.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define V280_CHANNEL_MASK ((1ULL << V280_CHANNEL_COUNT) - 1)
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Per-channel edge tracking during a tuning run. */
+typedef struct v280_tune_state_t {
+  uint64_t states;
+  /** Channels whose last edge time is known. */
+  uint64_t seen_mask;
+  uint64_t last_edge_ns[V280_CHANNEL_COUNT];
+  uint64_t threshold_ns;
+} v280_tune_state_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+/**
+ * Records the pulses ended by the edges in one sample.
+ *
+ * @param  state        Edge tracking state.
+ * @param  result       Result holding the histograms.
+ * @param  states       48-bit input states of the sample.
+ * @param  timestamp_ns Time of the sample.
+ */
+static void v280_tune_process(v280_tune_state_t* restrict state,
+    v280_tune_result_t* restrict result, uint64_t states, uint64_t timestamp_ns) {
+  uint64_t changed = (states ^ state->states) & V280_CHANNEL_MASK;
+  const uint64_t previous = state->states;
+  state->states = states;
+
+  while (changed != 0) {
+    const uint8_t channel = (uint8_t)__builtin_ctzll(changed);
+    const uint64_t bit = 1ULL << channel;
+    changed &= changed - 1;
+
+    v280_tune_group_t* group = &result->groups[V280_DEBOUNCE_GROUP_OF_BIT(channel)];
+    group->edges++;
+
+    const uint64_t width_ns = timestamp_ns - state->last_edge_ns[channel];
+    state->last_edge_ns[channel] = timestamp_ns;
+    if ((state->seen_mask & bit) == 0) {
+      state->seen_mask |= bit;
+      continue;
+    }
+    if (width_ns >= state->threshold_ns) continue;
+
+    const uint32_t width_us = (uint32_t)((width_ns + 999) / 1000);
+    uint32_t bin = width_us / result->bin_width_us;
+    if (bin >= V280_TUNE_BIN_COUNT) bin = V280_TUNE_BIN_COUNT - 1;
+    if (previous & bit) {
+      group->high[bin]++;
+      if (width_us > group->max_high_us) group->max_high_us = width_us;
+    } else {
+      group->low[bin]++;
+      if (width_us > group->max_low_us) group->max_low_us = width_us;
+    }
+  }
+}
+
+/**
+ * Converts the longest observed bounce into a debounce register value.
+ *
+ * @param  max_us             Longest observed bounce (0 if none).
+ * @param  margin_percent     Margin to add.
+ * @param  sample_interval_us Shortest bounce the run could resolve.
+ * @return Debounce time in register units.
+ */
+static uint16_t v280_tune_recommend(uint32_t max_us, uint32_t margin_percent,
+    uint64_t sample_interval_us) {
+  if (max_us == 0) return 0;
+  uint64_t us = (uint64_t)max_us * (100 + margin_percent) / 100;
+  if (us < sample_interval_us) us = sample_interval_us;
+  uint64_t units = (us + V280_TUNE_DEBOUNCE_UNIT_US - 1) / V280_TUNE_DEBOUNCE_UNIT_US;
+  return (units > UINT16_MAX) ? UINT16_MAX : (uint16_t)units;
+}
+
+int v280_tune_debounce(V120_HANDLE* restrict hV120, VME_REGION* restrict v280_region,
+    const v280_tune_options_t* restrict options, v280_tune_result_t* restrict result) {
+  if (hV120 == NULL || v280_region == NULL || options == NULL || result == NULL) return -1;
+  if (options->bounce_threshold_us == 0) return -1;
+
+  memset(result, 0, sizeof(v280_tune_result_t));
+  result->bin_width_us = (options->bounce_threshold_us + V280_TUNE_BIN_COUNT - 1) /
+      V280_TUNE_BIN_COUNT;
+  if (v280_get_debounce_config(hV120, v280_region, &result->previous) != 0) return -1;
+
+  /** Bounce can only be observed while the module is not filtering it. */
+  const v280_debounce_config_t unfiltered = {0};
+  if (v280_set_debounce_config(hV120, v280_region, &unfiltered) != 0) {
+    printf("v280_tune_debounce: Failed to clear debounce times\n");
+    v280_set_debounce_config(hV120, v280_region, &result->previous);
+    return -1;
+  }
+
+  /** Groups are separate registers, so a torn read across them does not distort any group. */
+  v280_tune_state_t state = { .threshold_ns = (uint64_t)options->bounce_threshold_us * 1000ULL };
+  const uint64_t start_ns = v280_get_time_ns();
+  const uint64_t end_ns = start_ns + (uint64_t)options->duration_ms * 1000000ULL;
+  uint64_t now_ns = start_ns;
+  int status = v280_get_input_states(v280_region, &state.states);
+  while (status == 0 && now_ns < end_ns) {
+    uint64_t states;
+    if ((status = v280_get_input_states(v280_region, &states)) != 0) break;
+    now_ns = v280_get_time_ns();
+    result->samples++;
+    v280_tune_process(&state, result, states, now_ns);
+  }
+  if (result->samples != 0) result->sample_interval_ns = (now_ns - start_ns) / result->samples;
+
+  const uint64_t sample_interval_us = (result->sample_interval_ns + 999) / 1000;
+  for (uint8_t group = 0; group < V280_DEBOUNCE_GROUP_COUNT; group++) {
+    result->recommended.rise[group] = v280_tune_recommend(result->groups[group].max_high_us,
+        options->margin_percent, sample_interval_us);
+    result->recommended.fall[group] = v280_tune_recommend(result->groups[group].max_low_us,
+        options->margin_percent, sample_interval_us);
+  }
+
+  const v280_debounce_config_t* target = options->apply ? &result->recommended : &result->previous;
+  int target_status = v280_set_debounce_config(hV120, v280_region, target);
+  if (status != 0) return -1;
+  return target_status;
+}
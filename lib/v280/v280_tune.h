@@ -0,0 +1,98 @@
+/**
+ * Public API for V280 debounce tuning.
+ *
+ * A tuning run sets every debounce time to zero and samples the inputs as fast as the bus allows
+ * for a fixed time. It then records the width of every pulse shorter than a bounce threshold, in
+ * per-group histograms. Short high pulses are what the rise debounce must reject and short low
+ * pulses are what the fall debounce must reject, so the longest of each, plus a margin, gives the
+ * shortest debounce times that would have removed all of the observed bounce.
+ *
+ * Bounce is only observed while the inputs are actually switching, so the run should cover normal
+ * operation of the connected contacts.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+#include "v280.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Number of bins in each pulse width histogram. */
+#define V280_TUNE_BIN_COUNT 64
+
+/** Resolution of the debounce registers. */
+#define V280_TUNE_DEBOUNCE_UNIT_US 10
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** V280 Debounce Tuning Options. */
+typedef struct v280_tune_options_t {
+  uint32_t duration_ms;           /** Measurement time. */
+  uint32_t bounce_threshold_us;   /** Pulses shorter than this are counted as bounce. */
+  uint32_t margin_percent;        /** Margin added to the longest observed bounce. */
+  bool apply;                     /** Apply the recommendation instead of restoring. */
+} v280_tune_options_t;
+
+/** V280 Pulse Width Histograms of one 16-channel group. */
+typedef struct v280_tune_group_t {
+  uint32_t high[V280_TUNE_BIN_COUNT];   /** Short high pulses by width. */
+  uint32_t low[V280_TUNE_BIN_COUNT];    /** Short low pulses by width. */
+  uint64_t edges;                       /** Number of edges seen in the group. */
+  uint32_t max_high_us;                 /** Longest short high pulse (0 if none). */
+  uint32_t max_low_us;                  /** Longest short low pulse (0 if none). */
+} v280_tune_group_t;
+
+/** V280 Debounce Tuning Result. */
+typedef struct v280_tune_result_t {
+  /** Histograms of the inputs debounced by rise[g] and fall[g]. */
+  v280_tune_group_t groups[V280_DEBOUNCE_GROUP_COUNT];
+  uint32_t bin_width_us;                /** Width of each histogram bin. */
+  uint64_t samples;                     /** Number of input samples taken. */
+  uint64_t sample_interval_ns;          /** Mean time between samples. */
+  v280_debounce_config_t previous;      /** Debounce times before the run. */
+  v280_debounce_config_t recommended;   /** Shortest debounce times that remove observed bounce. */
+} v280_tune_result_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Runs a debounce tuning measurement on a V280 module. The calling thread samples the inputs for
+ * the whole duration. Afterwards the previous debounce times are restored, or the recommended
+ * times are applied if options->apply is set.
+ *
+ * The recommendation for each group is the longest observed bounce of the matching polarity plus
+ * the margin, rounded up to the register resolution. Pulses shorter than the sample interval
+ * cannot be seen, so a group with any bounce is never recommended less than one sample interval.
+ *
+ * @param  hV120       Handle to the V120 library.
+ * @param  v280_region VME region of the V280 module.
+ * @param  options     Tuning options.
+ * @param  result      Storage for the histograms and recommendation.
+ * @return 0 on success, -1 on failure, -2 if the final debounce times did not verify.
+ */
+int v280_tune_debounce(
+  V120_HANDLE* restrict hV120,
+  VME_REGION* restrict v280_region,
+  const v280_tune_options_t* restrict options,
+  v280_tune_result_t* restrict result
+);
@@ -0,0 +1,357 @@
+/**
+ * Implementation of the V280-Triggered V230 Capture.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "v230.h"
+#include "v280.h"
+#include "vme_capture.h"
+#include "vme_clock.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define V280_CHANNEL_MASK ((1ULL << V280_CHANNEL_COUNT) - 1)
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Capture Engine. */
+struct vme_capture_t {
+  V120_HANDLE* hV120;
+  VME_REGION* v280_region;
+  VME_REGION* v230_region;
+  vme_capture_options_t options;
+  uint64_t pre_ns;
+  uint64_t post_ns;
+  /** Samples per record: room for max_pre_samples before and max_post_samples after the edge. */
+  uint32_t record_samples;
+
+  /** Newest max_pre_samples scans; history_head is the next slot to write. */
+  vme_capture_sample_t* history;
+  uint32_t history_count;
+  uint32_t history_head;
+  /** Timestamp of the newest scan dropped from the full history. */
+  bool has_evicted;
+  uint64_t evicted_ns;
+
+  bool has_scan_count;
+  uint16_t scan_count;
+  bool has_states;
+  uint64_t states;
+
+  /** Record queue: record i owns samples [i * record_samples, (i + 1) * record_samples). */
+  vme_capture_record_t* records;
+  vme_capture_sample_t* samples;
+  size_t record_mask;
+  _Atomic size_t head;
+  _Atomic size_t tail;
+  /** True while the record at head is being filled. */
+  bool capturing;
+
+  /** Guards stats. */
+  pthread_mutex_t lock;
+  vme_capture_stats_t stats;
+
+  pthread_t thread;
+  bool thread_active;
+  atomic_bool stop_requested;
+  uint64_t interval_ns;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+vme_capture_t* vme_capture_create(V120_HANDLE* restrict hV120, VME_REGION* restrict v280_region,
+    VME_REGION* restrict v230_region, const vme_capture_options_t* restrict options) {
+  if (hV120 == NULL || v280_region == NULL || v230_region == NULL || options == NULL) return NULL;
+  if (((options->rise_mask | options->fall_mask) & V280_CHANNEL_MASK) == 0) return NULL;
+  if (options->max_pre_samples == 0 || options->max_post_samples == 0) return NULL;
+  if (options->record_capacity == 0) return NULL;
+
+  vme_capture_t* capture = malloc(sizeof(vme_capture_t));
+  if (capture == NULL) {
+    printf("vme_capture_create: Failed to allocate memory for capture engine\n");
+    return NULL;
+  }
+  memset(capture, 0, sizeof(vme_capture_t));
+
+  size_t record_count = 1;
+  while (record_count < options->record_capacity) record_count <<= 1;
+  const size_t record_samples = (size_t)options->max_pre_samples + options->max_post_samples;
+  capture->history = malloc((size_t)options->max_pre_samples * sizeof(vme_capture_sample_t));
+  capture->records = malloc(record_count * sizeof(vme_capture_record_t));
+  capture->samples = malloc(record_count * record_samples * sizeof(vme_capture_sample_t));
+  if (capture->history == NULL || capture->records == NULL || capture->samples == NULL) {
+    printf("vme_capture_create: Failed to allocate memory for capture buffers\n");
+    free(capture->history);
+    free(capture->records);
+    free(capture->samples);
+    free(capture);
+    return NULL;
+  }
+
+  capture->hV120 = hV120;
+  capture->v280_region = v280_region;
+  capture->v230_region = v230_region;
+  capture->options = *options;
+  capture->pre_ns = (uint64_t)options->pre_us * 1000ULL;
+  capture->post_ns = (uint64_t)options->post_us * 1000ULL;
+  capture->record_samples = (uint32_t)record_samples;
+  capture->record_mask = record_count - 1;
+  atomic_init(&capture->head, 0);
+  atomic_init(&capture->tail, 0);
+  pthread_mutex_init(&capture->lock, NULL);
+  atomic_init(&capture->stop_requested, false);
+  return capture;
+}
+
+void vme_capture_delete(vme_capture_t* restrict capture) {
+  if (capture == NULL) return;
+  vme_capture_stop(capture);
+  pthread_mutex_destroy(&capture->lock);
+  free(capture->history);
+  free(capture->records);
+  free(capture->samples);
+  free(capture);
+}
+
+/**
+ * Gets the samples of a queued record.
+ *
+ * @param  capture Capture engine.
+ * @param  index   Queue position of the record.
+ * @return Pointer to the first sample of the record.
+ */
+static inline vme_capture_sample_t* vme_capture_record_samples(vme_capture_t* restrict capture,
+    size_t index) {
+  return &capture->samples[(index & capture->record_mask) * capture->record_samples];
+}
+
+/**
+ * Reads a fresh V230 scan into the history, if the scan counter has advanced.
+ *
+ * @param  capture Capture engine.
+ * @param  sample  Storage for a pointer to the new sample, or NULL if there was no fresh scan.
+ * @return 0 on success, -1 on failure.
+ */
+static int vme_capture_read_scan(vme_capture_t* restrict capture,
+    const vme_capture_sample_t** restrict sample) {
+  *sample = NULL;
+  uint16_t scan_count;
+  if (v230_get_scan_count(capture->v230_region, &scan_count) < 0) return -1;
+  const bool fresh = capture->has_scan_count && scan_count != capture->scan_count;
+  capture->scan_count = scan_count;
+  capture->has_scan_count = true;
+  if (!fresh) return 0;
+
+  /** The history is only touched once the scan has been read, so a failed read evicts nothing. */
+  const uint64_t timestamp_ns = vme_clock_get_time_ns();
+  v230_channel_voltage_t voltages;
+  if (v230_get_all_channel_voltages(capture->hV120, capture->v230_region, &voltages) < 0) {
+    return -1;
+  }
+
+  vme_capture_sample_t* next = &capture->history[capture->history_head];
+  if (capture->history_count == capture->options.max_pre_samples) {
+    capture->evicted_ns = next->timestamp_ns;
+    capture->has_evicted = true;
+  }
+  next->timestamp_ns = timestamp_ns;
+  memcpy(next->voltage, voltages.voltage, sizeof(next->voltage));
+
+  const uint32_t max_pre_samples = capture->options.max_pre_samples;
+  capture->history_head = (capture->history_head + 1) % max_pre_samples;
+  if (capture->history_count < max_pre_samples) capture->history_count++;
+  *sample = next;
+  return 0;
+}
+
+/**
+ * Opens a record for an edge and copies the scans within the pre-trigger window into it. The
+ * history holds at most max_pre_samples scans, so the rest of the record is left for the scans
+ * after the edge.
+ *
+ * @param  capture Capture engine.
+ * @param  edge_ns Time of the edge.
+ * @param  states  V280 input states after the edge.
+ * @param  edges   Selected channels that changed.
+ */
+static void vme_capture_open(vme_capture_t* restrict capture, uint64_t edge_ns, uint64_t states,
+    uint64_t edges) {
+  const size_t head = atomic_load_explicit(&capture->head, memory_order_relaxed);
+  vme_capture_record_t* record = &capture->records[head & capture->record_mask];
+  vme_capture_sample_t* samples = vme_capture_record_samples(capture, head);
+  const uint64_t window_start_ns = (edge_ns > capture->pre_ns) ? edge_ns - capture->pre_ns : 0;
+
+  const uint32_t max_pre_samples = capture->options.max_pre_samples;
+  uint32_t index = (capture->history_head + max_pre_samples - capture->history_count) %
+      max_pre_samples;
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < capture->history_count; i++) {
+    const vme_capture_sample_t* sample = &capture->history[index];
+    if (sample->timestamp_ns >= window_start_ns) samples[count++] = *sample;
+    index = (index + 1) % max_pre_samples;
+  }
+
+  record->edge_ns = edge_ns;
+  record->states = states;
+  record->edges = edges;
+  record->pre_count = count;
+  record->sample_count = count;
+  record->truncated = capture->has_evicted && capture->evicted_ns >= window_start_ns;
+  capture->capturing = true;
+}
+
+int vme_capture_poll(vme_capture_t* restrict capture) {
+  if (capture == NULL) return -1;
+  const size_t head = atomic_load_explicit(&capture->head, memory_order_relaxed);
+  vme_capture_record_t* record = &capture->records[head & capture->record_mask];
+  uint64_t scans = 0, dropped = 0, overlapped = 0, records = 0, errors = 0;
+
+  /** Scans are read first, so a scan read on the poll that sees an edge precedes the edge. */
+  const vme_capture_sample_t* sample;
+  int status = vme_capture_read_scan(capture, &sample);
+  if (status != 0) {
+    errors++;
+  } else if (sample != NULL) {
+    scans++;
+    if (capture->capturing && sample->timestamp_ns <= record->edge_ns + capture->post_ns) {
+      if (record->sample_count - record->pre_count < capture->options.max_post_samples) {
+        vme_capture_record_samples(capture, head)[record->sample_count++] = *sample;
+      } else {
+        record->truncated = true;
+      }
+    }
+  }
+
+  uint64_t states;
+  const uint64_t now_ns = vme_clock_get_time_ns();
+  int v280_status = v280_get_input_states_stable(capture->v280_region,
+      V280_SNAPSHOT_DEFAULT_RETRIES, &states);
+  if (v280_status != 0) {
+    errors++;
+    if (status == 0) status = v280_status;
+  } else {
+    states &= V280_CHANNEL_MASK;
+    if (capture->has_states) {
+      const uint64_t changed = states ^ capture->states;
+      const uint64_t edges = (changed & states & capture->options.rise_mask) |
+          (changed & ~states & capture->options.fall_mask);
+      if (edges != 0) {
+        const size_t tail = atomic_load_explicit(&capture->tail, memory_order_acquire);
+        if (capture->capturing) {
+          overlapped++;
+        } else if (head - tail > capture->record_mask) {
+          dropped++;
+        } else {
+          vme_capture_open(capture, now_ns, states, edges);
+        }
+      }
+    }
+    capture->states = states;
+    capture->has_states = true;
+  }
+
+  if (capture->capturing && now_ns >= record->edge_ns + capture->post_ns) {
+    capture->capturing = false;
+    atomic_store_explicit(&capture->head, head + 1, memory_order_release);
+    records++;
+  }
+
+  pthread_mutex_lock(&capture->lock);
+  capture->stats.polls++;
+  capture->stats.scans += scans;
+  capture->stats.records += records;
+  capture->stats.dropped += dropped;
+  capture->stats.overlapped += overlapped;
+  capture->stats.errors += errors;
+  pthread_mutex_unlock(&capture->lock);
+  return status;
+}
+
+/**
+ * Polling thread: calls vme_capture_poll() on an absolute-deadline schedule until stopped.
+ *
+ * @param  arg Capture engine.
+ * @return NULL.
+ */
+static void* vme_capture_run(void* arg) {
+  vme_capture_t* capture = (vme_capture_t*)arg;
+  uint64_t deadline_ns = vme_clock_get_time_ns();
+  while (!atomic_load_explicit(&capture->stop_requested, memory_order_relaxed)) {
+    vme_capture_poll(capture);
+    deadline_ns += capture->interval_ns;
+    uint64_t now_ns = vme_clock_get_time_ns();
+    if (deadline_ns < now_ns) deadline_ns = now_ns;
+    struct timespec deadline = {
+      .tv_sec = (time_t)(deadline_ns / 1000000000ULL),
+      .tv_nsec = (long)(deadline_ns % 1000000000ULL),
+    };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+  }
+  return NULL;
+}
+
+int vme_capture_start(vme_capture_t* restrict capture, uint32_t interval_us) {
+  if (capture == NULL || capture->thread_active || interval_us == 0) return -1;
+  capture->interval_ns = (uint64_t)interval_us * 1000ULL;
+  atomic_store(&capture->stop_requested, false);
+  if (pthread_create(&capture->thread, NULL, vme_capture_run, capture) != 0) {
+    printf("vme_capture_start: Failed to create polling thread\n");
+    return -1;
+  }
+  capture->thread_active = true;
+  return 0;
+}
+
+int vme_capture_stop(vme_capture_t* restrict capture) {
+  if (capture == NULL) return -1;
+  if (!capture->thread_active) return 0;
+  atomic_store(&capture->stop_requested, true);
+  if (pthread_join(capture->thread, NULL) != 0) return -1;
+  capture->thread_active = false;
+  capture->capturing = false;
+  return 0;
+}
+
+int vme_capture_pop(vme_capture_t* restrict capture, vme_capture_record_t* restrict record,
+    vme_capture_sample_t* restrict samples, size_t max_samples) {
+  if (capture == NULL || record == NULL || (samples == NULL && max_samples > 0)) return -1;
+  const size_t tail = atomic_load_explicit(&capture->tail, memory_order_relaxed);
+  if (tail == atomic_load_explicit(&capture->head, memory_order_acquire)) return -2;
+
+  *record = capture->records[tail & capture->record_mask];
+  const size_t count = (record->sample_count < max_samples) ? record->sample_count : max_samples;
+  if (count > 0) {
+    memcpy(samples, vme_capture_record_samples(capture, tail),
+        count * sizeof(vme_capture_sample_t));
+  }
+  atomic_store_explicit(&capture->tail, tail + 1, memory_order_release);
+  return 0;
+}
+
+int vme_capture_get_stats(vme_capture_t* restrict capture, vme_capture_stats_t* restrict stats) {
+  if (capture == NULL || stats == NULL) return -1;
+  pthread_mutex_lock(&capture->lock);
+  *stats = capture->stats;
+  pthread_mutex_unlock(&capture->lock);
+  return 0;
+}
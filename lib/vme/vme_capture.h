@@ -0,0 +1,160 @@
+/**
+ * Public API for V280-triggered V230 capture.
+ *
+ * A capture engine polls one V280 and one V230 from a single thread and stamps both with
+ * CLOCK_MONOTONIC, so edges and analog scans share one host time axis without manual alignment.
+ * Every fresh V230 scan (detected by its scan counter advancing) is kept in a pre-trigger history.
+ * When a selected V280 edge occurs, the scans within the pre-trigger window are copied into a
+ * record, the scans that follow are appended until the post-trigger window has elapsed, and the
+ * completed record, holding the edge and its analog window, is queued for the application.
+ *
+ * V230 scans are stamped when they are detected, so a scan's timestamp lags its completion by at
+ * most one poll interval; V280 states are stamped when they are read.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+#include "v230.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Capture Options. */
+typedef struct vme_capture_options_t {
+  uint64_t rise_mask;         /** V280 channels whose rising edges trigger a capture. */
+  uint64_t fall_mask;         /** V280 channels whose falling edges trigger a capture. */
+  uint32_t pre_us;            /** Length of the window before the edge. */
+  uint32_t post_us;           /** Length of the window after the edge. */
+  uint32_t max_pre_samples;   /** Maximum number of V230 scans before the edge (at least 1). */
+  uint32_t max_post_samples;  /** Maximum number of V230 scans after the edge (at least 1). */
+  uint32_t record_capacity;   /** Minimum number of completed records the queue can hold. */
+} vme_capture_options_t;
+
+/** V230 Scan in a Capture. */
+typedef struct vme_capture_sample_t {
+  uint64_t timestamp_ns;                /** CLOCK_MONOTONIC time at which the scan was read. */
+  float voltage[V230_NUM_CHANNELS];     /** Voltages of all channels. */
+} vme_capture_sample_t;
+
+/** Correlated Capture Record. */
+typedef struct vme_capture_record_t {
+  uint64_t edge_ns;         /** CLOCK_MONOTONIC time of the V280 read that saw the edge. */
+  uint64_t states;          /** 48-bit V280 input states after the edge. */
+  uint64_t edges;           /** Selected V280 channels that changed. */
+  uint32_t pre_count;       /** Number of samples before the edge. */
+  uint32_t sample_count;    /** Number of samples in the record. */
+  bool truncated;           /** True if either window held more scans than its maximum. */
+} vme_capture_record_t;
+
+/** Capture Statistics. */
+typedef struct vme_capture_stats_t {
+  uint64_t polls;           /** Number of polls. */
+  uint64_t scans;           /** Number of fresh V230 scans read. */
+  uint64_t records;         /** Number of records completed. */
+  uint64_t dropped;         /** Edges not captured because the record queue was full. */
+  uint64_t overlapped;      /** Edges not captured because a capture was already open. */
+  uint64_t errors;          /** Number of failed or unstable reads. */
+} vme_capture_stats_t;
+
+/** Capture Engine (opaque). */
+typedef struct vme_capture_t vme_capture_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates a capture engine. The regions remain owned by the caller.
+ *
+ * @param  hV120       Handle to the V120 library.
+ * @param  v280_region VME region of the V280 module that triggers captures.
+ * @param  v230_region VME region of the V230 module that is captured.
+ * @param  options     Capture options.
+ * @return Pointer to the capture engine, or NULL on failure.
+ */
+vme_capture_t* vme_capture_create(
+  V120_HANDLE* restrict hV120,
+  VME_REGION* restrict v280_region,
+  VME_REGION* restrict v230_region,
+  const vme_capture_options_t* restrict options
+);
+
+/**
+ * Stops the polling thread if it is running and deletes the capture engine.
+ *
+ * @param  capture Capture engine to delete.
+ */
+void vme_capture_delete(vme_capture_t* restrict capture);
+
+/**
+ * Polls both modules once: reads the V230 if a fresh scan is available, then the V280, and
+ * starts, extends or completes a capture. Must not be called while the polling thread runs.
+ *
+ * @param  capture Capture engine.
+ * @return 0 on success, -1 on failure, -2 if the V280 inputs did not stabilize.
+ */
+int vme_capture_poll(vme_capture_t* restrict capture);
+
+/**
+ * Starts a thread that calls vme_capture_poll() periodically.
+ *
+ * @param  capture     Capture engine.
+ * @param  interval_us Poll period in microseconds.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_capture_start(vme_capture_t* restrict capture, uint32_t interval_us);
+
+/**
+ * Stops the polling thread and waits for it to exit. A capture that is still open is discarded.
+ *
+ * @param  capture Capture engine.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_capture_stop(vme_capture_t* restrict capture);
+
+/**
+ * Pops the oldest completed record without blocking. The queue must be consumed by a single
+ * thread.
+ *
+ * @param  capture     Capture engine.
+ * @param  record      Storage for the record.
+ * @param  samples     Storage for the samples of the record.
+ * @param  max_samples Number of samples that fit in samples (at least options.max_pre_samples
+ *                     plus options.max_post_samples to receive every sample; samples past it
+ *                     are not copied).
+ * @return 0 if a record was popped, -1 on failure, -2 if the queue is empty.
+ */
+int vme_capture_pop(
+  vme_capture_t* restrict capture,
+  vme_capture_record_t* restrict record,
+  vme_capture_sample_t* restrict samples,
+  size_t max_samples
+);
+
+/**
+ * Gets the capture statistics.
+ *
+ * @param  capture Capture engine.
+ * @param  stats   Storage for the statistics.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_capture_get_stats(vme_capture_t* restrict capture, vme_capture_stats_t* restrict stats);
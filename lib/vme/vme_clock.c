@@ -0,0 +1,285 @@
+/**
+ * Implementation of the Extended Module Timestamps.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vme_clock.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Number of ticks in one mcount wrap. */
+#define VME_CLOCK_WRAP_TICKS 65536.0
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Module Clock. */
+struct vme_clock_t {
+  VME_REGION* region;
+  vme_clock_read_fn read_mcount;
+
+  /** Readings in the fit window, oldest at head once full. */
+  vme_clock_stamp_t* samples;
+  uint32_t window;
+  uint32_t sample_count;
+  uint32_t head;
+
+  uint16_t last_mcount;
+  uint64_t ticks;
+  /** Tick period used to recover missed wraps; unlike the fit, never skewed by a bad reading. */
+  double nominal_tick_ns;
+
+  /** Current fit. Guarded by lock. */
+  pthread_mutex_t lock;
+  vme_clock_fit_t fit;
+
+  pthread_t thread;
+  bool thread_active;
+  atomic_bool stop_requested;
+  uint64_t interval_ns;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+uint64_t vme_clock_get_time_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+vme_clock_t* vme_clock_create(VME_REGION* restrict region, vme_clock_read_fn read_mcount,
+    double nominal_tick_ns, uint32_t window) {
+  if (region == NULL || read_mcount == NULL || !(nominal_tick_ns > 0.0)) return NULL;
+  if (window == 0) window = VME_CLOCK_DEFAULT_WINDOW;
+
+  vme_clock_t* clock = malloc(sizeof(vme_clock_t));
+  if (clock == NULL) {
+    printf("vme_clock_create: Failed to allocate memory for clock\n");
+    return NULL;
+  }
+  memset(clock, 0, sizeof(vme_clock_t));
+
+  clock->samples = malloc(window * sizeof(*clock->samples));
+  if (clock->samples == NULL) {
+    printf("vme_clock_create: Failed to allocate memory for fit window\n");
+    free(clock);
+    return NULL;
+  }
+
+  clock->region = region;
+  clock->read_mcount = read_mcount;
+  clock->window = window;
+  clock->nominal_tick_ns = nominal_tick_ns;
+  clock->fit.tick_ns = nominal_tick_ns;
+  pthread_mutex_init(&clock->lock, NULL);
+  atomic_init(&clock->stop_requested, false);
+  return clock;
+}
+
+void vme_clock_delete(vme_clock_t* restrict clock) {
+  if (clock == NULL) return;
+  vme_clock_stop(clock);
+  pthread_mutex_destroy(&clock->lock);
+  free(clock->samples);
+  free(clock);
+}
+
+/**
+ * Refits host time against ticks over the readings in the window. The newest reading is the
+ * reference point so that extrapolation to the present loses no precision.
+ *
+ * @param  clock Clock, with lock held.
+ */
+static void vme_clock_refit(vme_clock_t* restrict clock) {
+  const uint32_t newest = (clock->head + clock->window - 1) % clock->window;
+  const vme_clock_stamp_t reference = clock->samples[newest];
+  const uint32_t n = clock->sample_count;
+
+  double sum_x = 0.0, sum_y = 0.0;
+  for (uint32_t i = 0; i < n; i++) {
+    sum_x += (double)(int64_t)(clock->samples[i].ticks - reference.ticks);
+    sum_y += (double)(int64_t)(clock->samples[i].host_ns - reference.host_ns);
+  }
+  const double mean_x = sum_x / n, mean_y = sum_y / n;
+
+  double sxx = 0.0, sxy = 0.0;
+  for (uint32_t i = 0; i < n; i++) {
+    double dx = (double)(int64_t)(clock->samples[i].ticks - reference.ticks) - mean_x;
+    double dy = (double)(int64_t)(clock->samples[i].host_ns - reference.host_ns) - mean_y;
+    sxx += dx * dx;
+    sxy += dx * dy;
+  }
+  /** Until the readings span at least one tick, keep the previous (or nominal) period. */
+  double tick_ns = (sxx > 0.0) ? sxy / sxx : clock->fit.tick_ns;
+  double intercept = mean_y - tick_ns * mean_x;
+
+  double residual = 0.0;
+  for (uint32_t i = 0; i < n; i++) {
+    double x = (double)(int64_t)(clock->samples[i].ticks - reference.ticks);
+    double y = (double)(int64_t)(clock->samples[i].host_ns - reference.host_ns);
+    double error = y - (intercept + tick_ns * x);
+    residual += error * error;
+  }
+
+  clock->fit.tick_ns = tick_ns;
+  clock->fit.tick_offset = reference.ticks;
+  clock->fit.host_offset_ns = reference.host_ns + (uint64_t)llround(intercept);
+  clock->fit.residual_ns = sqrt(residual / n);
+  clock->fit.samples = n;
+}
+
+int vme_clock_update(vme_clock_t* restrict clock, vme_clock_stamp_t* restrict stamp) {
+  if (clock == NULL) return -1;
+
+  /**
+   * The read is made under the lock so concurrent updates are applied in the order they were read.
+   * The host time of the reading is taken as the midpoint of the bus cycle.
+   */
+  pthread_mutex_lock(&clock->lock);
+  uint16_t mcount;
+  uint64_t before_ns = vme_clock_get_time_ns();
+  if (clock->read_mcount(clock->region, &mcount) != 0) {
+    pthread_mutex_unlock(&clock->lock);
+    return -1;
+  }
+  uint64_t host_ns = before_ns + (vme_clock_get_time_ns() - before_ns) / 2;
+
+  if (clock->fit.updates != 0) {
+    /** Whole wraps between readings are invisible in mcount, so recover them from host time. */
+    const vme_clock_stamp_t* last = &clock->samples[(clock->head + clock->window - 1) %
+        clock->window];
+    double expected = (double)(host_ns - last->host_ns) / clock->nominal_tick_ns;
+    uint16_t delta = (uint16_t)(mcount - clock->last_mcount);
+    long long wraps = llround((expected - delta) / VME_CLOCK_WRAP_TICKS);
+    if (wraps < 0) wraps = 0;
+    clock->ticks += delta + (uint64_t)wraps * (uint64_t)VME_CLOCK_WRAP_TICKS;
+  } else {
+    clock->ticks = mcount;
+  }
+  clock->last_mcount = mcount;
+
+  clock->samples[clock->head] = (vme_clock_stamp_t){ .ticks = clock->ticks, .host_ns = host_ns };
+  clock->head = (clock->head + 1) % clock->window;
+  if (clock->sample_count < clock->window) clock->sample_count++;
+  clock->fit.updates++;
+  vme_clock_refit(clock);
+  uint64_t ticks = clock->ticks;
+  pthread_mutex_unlock(&clock->lock);
+
+  if (stamp != NULL) {
+    stamp->ticks = ticks;
+    stamp->host_ns = host_ns;
+  }
+  return 0;
+}
+
+/**
+ * Update thread: calls vme_clock_update() on an absolute-deadline schedule until stopped.
+ *
+ * @param  arg Clock.
+ * @return NULL.
+ */
+static void* vme_clock_run(void* arg) {
+  vme_clock_t* clock = (vme_clock_t*)arg;
+  uint64_t deadline_ns = vme_clock_get_time_ns();
+  while (!atomic_load_explicit(&clock->stop_requested, memory_order_relaxed)) {
+    vme_clock_update(clock, NULL);
+    deadline_ns += clock->interval_ns;
+    uint64_t now_ns = vme_clock_get_time_ns();
+    if (deadline_ns < now_ns) deadline_ns = now_ns;
+    struct timespec deadline = {
+      .tv_sec = (time_t)(deadline_ns / 1000000000ULL),
+      .tv_nsec = (long)(deadline_ns % 1000000000ULL),
+    };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+  }
+  return NULL;
+}
+
+int vme_clock_start(vme_clock_t* restrict clock, uint32_t interval_ms) {
+  if (clock == NULL || clock->thread_active || interval_ms == 0) return -1;
+  clock->interval_ns = (uint64_t)interval_ms * 1000000ULL;
+  atomic_store(&clock->stop_requested, false);
+  if (pthread_create(&clock->thread, NULL, vme_clock_run, clock) != 0) {
+    printf("vme_clock_start: Failed to create update thread\n");
+    return -1;
+  }
+  clock->thread_active = true;
+  return 0;
+}
+
+int vme_clock_stop(vme_clock_t* restrict clock) {
+  if (clock == NULL) return -1;
+  if (!clock->thread_active) return 0;
+  atomic_store(&clock->stop_requested, true);
+  if (pthread_join(clock->thread, NULL) != 0) return -1;
+  clock->thread_active = false;
+  return 0;
+}
+
+/**
+ * Copies the current fit.
+ *
+ * @param  clock Clock.
+ * @param  fit   Storage for the fit.
+ * @return 0 on success, -2 if the clock has no readings yet.
+ */
+static int vme_clock_load_fit(vme_clock_t* restrict clock, vme_clock_fit_t* restrict fit) {
+  pthread_mutex_lock(&clock->lock);
+  *fit = clock->fit;
+  pthread_mutex_unlock(&clock->lock);
+  return (fit->updates == 0) ? -2 : 0;
+}
+
+int vme_clock_now(vme_clock_t* restrict clock, vme_clock_stamp_t* restrict stamp) {
+  if (clock == NULL || stamp == NULL) return -1;
+  stamp->host_ns = vme_clock_get_time_ns();
+  return vme_clock_host_to_ticks(clock, stamp->host_ns, &stamp->ticks);
+}
+
+int vme_clock_ticks_to_host(vme_clock_t* restrict clock, uint64_t ticks,
+    uint64_t* restrict host_ns) {
+  if (clock == NULL || host_ns == NULL) return -1;
+  vme_clock_fit_t fit;
+  if (vme_clock_load_fit(clock, &fit) != 0) return -2;
+  double offset = (double)(int64_t)(ticks - fit.tick_offset) * fit.tick_ns;
+  *host_ns = fit.host_offset_ns + (uint64_t)llround(offset);
+  return 0;
+}
+
+int vme_clock_host_to_ticks(vme_clock_t* restrict clock, uint64_t host_ns,
+    uint64_t* restrict ticks) {
+  if (clock == NULL || ticks == NULL) return -1;
+  vme_clock_fit_t fit;
+  if (vme_clock_load_fit(clock, &fit) != 0) return -2;
+  double offset = (double)(int64_t)(host_ns - fit.host_offset_ns) / fit.tick_ns;
+  long long delta = llround(floor(offset));
+  *ticks = (delta < 0 && (uint64_t)(-delta) > fit.tick_offset) ? 0 :
+      fit.tick_offset + (uint64_t)delta;
+  return 0;
+}
+
+int vme_clock_get_fit(vme_clock_t* restrict clock, vme_clock_fit_t* restrict fit) {
+  if (clock == NULL || fit == NULL) return -1;
+  return vme_clock_load_fit(clock, fit);
+}
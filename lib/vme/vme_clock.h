@@ -0,0 +1,169 @@
+/**
+ * Public API for extended module timestamps.
+ *
+ * The V280 and V230 each provide a 16-bit mcount register that wraps quickly (every 65.5 seconds
+ * on the 1 kHz V280). A clock extends one module's mcount into a monotonic 64-bit tick count and
+ * keeps a least-squares fit of CLOCK_MONOTONIC against it over a sliding window of recent
+ * readings. Once the fit exists, data from any module can be placed on the host time axis without
+ * further bus reads.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Nominal mcount period of the V280 (1 kHz). */
+#define VME_CLOCK_V280_TICK_NS 1000000.0
+
+/** Default number of readings in the fit window. */
+#define VME_CLOCK_DEFAULT_WINDOW 64
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Reads the 16-bit mcount register of a module (v280_get_mcount, v230_get_mcount). */
+typedef int (*vme_clock_read_fn)(VME_REGION* restrict region, uint16_t* restrict mcount);
+
+/** Module Timestamp. */
+typedef struct vme_clock_stamp_t {
+  uint64_t ticks;     /** Extended 64-bit module tick count. */
+  uint64_t host_ns;   /** Corresponding CLOCK_MONOTONIC time. */
+} vme_clock_stamp_t;
+
+/** Module Clock Fit: host_ns = host_offset_ns + (ticks - tick_offset) * tick_ns. */
+typedef struct vme_clock_fit_t {
+  double tick_ns;           /** Measured tick period in nanoseconds. */
+  uint64_t tick_offset;     /** Reference tick count of the fit. */
+  uint64_t host_offset_ns;  /** Host time at the reference tick count. */
+  double residual_ns;       /** RMS residual of the readings in the window. */
+  uint32_t samples;         /** Number of readings in the window. */
+  uint64_t updates;         /** Number of readings since the clock was created. */
+} vme_clock_fit_t;
+
+/** Module Clock (opaque). */
+typedef struct vme_clock_t vme_clock_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Gets the current CLOCK_MONOTONIC time, the host time base of every timestamp in the VME library.
+ *
+ * @return Current time in nanoseconds.
+ */
+uint64_t vme_clock_get_time_ns(void);
+
+/**
+ * Creates a clock for one module. The region remains owned by the caller.
+ *
+ * @param  region          VME region of the module.
+ * @param  read_mcount     Function that reads the module's mcount register.
+ * @param  nominal_tick_ns Expected tick period, used until the fit has two readings and to
+ *                         recover wraps missed between widely spaced readings.
+ * @param  window          Number of readings in the fit window (0 for VME_CLOCK_DEFAULT_WINDOW).
+ * @return Pointer to the clock, or NULL on failure.
+ */
+vme_clock_t* vme_clock_create(
+  VME_REGION* restrict region,
+  vme_clock_read_fn read_mcount,
+  double nominal_tick_ns,
+  uint32_t window
+);
+
+/**
+ * Stops the update thread if it is running and deletes the clock.
+ *
+ * @param  clock Clock to delete.
+ */
+void vme_clock_delete(vme_clock_t* restrict clock);
+
+/**
+ * Reads mcount once, extends it, and adds the reading to the fit. The reading must happen at least
+ * once per mcount wrap unless the nominal tick period is accurate enough to recover missed wraps.
+ *
+ * @param  clock Clock.
+ * @param  stamp Optional storage for the module and host time of the reading.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_clock_update(vme_clock_t* restrict clock, vme_clock_stamp_t* restrict stamp);
+
+/**
+ * Starts a thread that calls vme_clock_update() periodically.
+ *
+ * @param  clock       Clock.
+ * @param  interval_ms Update period in milliseconds (must be shorter than the mcount wrap).
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_clock_start(vme_clock_t* restrict clock, uint32_t interval_ms);
+
+/**
+ * Stops the update thread and waits for it to exit.
+ *
+ * @param  clock Clock.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_clock_stop(vme_clock_t* restrict clock);
+
+/**
+ * Stamps the current instant with both host time and the fitted module time, without a bus read.
+ *
+ * @param  clock Clock.
+ * @param  stamp Storage for the timestamp.
+ * @return 0 on success, -1 on failure, -2 if the clock has no readings yet.
+ */
+int vme_clock_now(vme_clock_t* restrict clock, vme_clock_stamp_t* restrict stamp);
+
+/**
+ * Converts a module tick count to host time using the current fit.
+ *
+ * @param  clock   Clock.
+ * @param  ticks   Extended module tick count.
+ * @param  host_ns Storage for the CLOCK_MONOTONIC time.
+ * @return 0 on success, -1 on failure, -2 if the clock has no readings yet.
+ */
+int vme_clock_ticks_to_host(
+  vme_clock_t* restrict clock,
+  uint64_t ticks,
+  uint64_t* restrict host_ns
+);
+
+/**
+ * Converts a host time to a module tick count using the current fit.
+ *
+ * @param  clock   Clock.
+ * @param  host_ns CLOCK_MONOTONIC time.
+ * @param  ticks   Storage for the extended module tick count.
+ * @return 0 on success, -1 on failure, -2 if the clock has no readings yet.
+ */
+int vme_clock_host_to_ticks(
+  vme_clock_t* restrict clock,
+  uint64_t host_ns,
+  uint64_t* restrict ticks
+);
+
+/**
+ * Gets the current fit of the clock.
+ *
+ * @param  clock Clock.
+ * @param  fit   Storage for the fit.
+ * @return 0 on success, -1 on failure, -2 if the clock has no readings yet.
+ */
+int vme_clock_get_fit(vme_clock_t* restrict clock, vme_clock_fit_t* restrict fit);
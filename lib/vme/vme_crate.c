@@ -0,0 +1,166 @@
+/**
+ * Implementation of the Crate Context.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "v210.h"
+#include "v230.h"
+#include "v280.h"
+#include "vme_crate.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Alignment of the arena and of every slot in it. */
+#define VME_CRATE_CACHE_LINE_SIZE 64
+
+/** Rounds a size up to a whole number of cache lines. */
+#define VME_CRATE_ALIGN(size) \
+  (((size) + VME_CRATE_CACHE_LINE_SIZE - 1) & ~(size_t)(VME_CRATE_CACHE_LINE_SIZE - 1))
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Region management functions of one module type. */
+typedef struct vme_crate_module_ops_t {
+  size_t (*storage_size)(void);
+  VME_REGION* (*add_region_at)(V120_HANDLE* restrict hV120, const uint32_t vme_addr,
+      const V120_PD addr_mode, const char* restrict name, void* restrict storage);
+  /** NULL if regions of the type hold nothing outside their storage. */
+  void (*release_region)(VME_REGION* restrict region);
+} vme_crate_module_ops_t;
+
+/** Slots of one module type. */
+typedef struct vme_crate_slots_t {
+  char* storage;
+  size_t stride;
+  size_t capacity;
+  size_t count;
+  VME_REGION** regions;
+} vme_crate_slots_t;
+
+/** Crate Context; the first cache lines of its own arena. */
+struct vme_crate_t {
+  V120_HANDLE* hV120;
+  vme_crate_slots_t slots[VME_CRATE_TYPE_COUNT];
+  /** Cold V210 settle statistics, V210_CHANNEL_COUNT per slot, after all slots. */
+  v210_settle_stats_t* v210_settle_stats;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+static const vme_crate_module_ops_t vme_crate_modules[VME_CRATE_TYPE_COUNT] = {
+  [VME_CRATE_V210] = {
+    .storage_size = v210_get_region_storage_size,
+    .add_region_at = v210_add_region_at,
+    .release_region = v210_release_region,
+  },
+  [VME_CRATE_V230] = {
+    .storage_size = v230_get_region_storage_size,
+    .add_region_at = v230_add_region_at,
+    .release_region = NULL,
+  },
+  [VME_CRATE_V280] = {
+    .storage_size = v280_get_region_storage_size,
+    .add_region_at = v280_add_region_at,
+    .release_region = NULL,
+  },
+};
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+vme_crate_t* vme_crate_create(V120_HANDLE* restrict hV120, size_t v210_count, size_t v230_count,
+    size_t v280_count) {
+  if (hV120 == NULL) return NULL;
+  const size_t counts[VME_CRATE_TYPE_COUNT] = {v210_count, v230_count, v280_count};
+
+  /**
+   * Layout: crate context, the region pointer arrays, the slots of each type, then the V210
+   * settle statistics, which are only touched by verification and would otherwise spread the
+   * V210 slots over several kilobytes each.
+   */
+  size_t region_offsets[VME_CRATE_TYPE_COUNT], slot_offsets[VME_CRATE_TYPE_COUNT];
+  size_t size = VME_CRATE_ALIGN(sizeof(vme_crate_t));
+  for (int type = 0; type < VME_CRATE_TYPE_COUNT; type++) {
+    region_offsets[type] = size;
+    size += VME_CRATE_ALIGN(counts[type] * sizeof(VME_REGION*));
+  }
+  for (int type = 0; type < VME_CRATE_TYPE_COUNT; type++) {
+    slot_offsets[type] = size;
+    size += counts[type] * VME_CRATE_ALIGN(vme_crate_modules[type].storage_size());
+  }
+  const size_t settle_stats_offset = size;
+  size += VME_CRATE_ALIGN(v210_count * V210_CHANNEL_COUNT * sizeof(v210_settle_stats_t));
+
+  char* arena = aligned_alloc(VME_CRATE_CACHE_LINE_SIZE, size);
+  if (arena == NULL) {
+    printf("vme_crate_create: Failed to allocate memory for crate arena\n");
+    return NULL;
+  }
+
+  vme_crate_t* crate = (vme_crate_t*)arena;
+  memset(crate, 0, sizeof(vme_crate_t));
+  crate->hV120 = hV120;
+  for (int type = 0; type < VME_CRATE_TYPE_COUNT; type++) {
+    vme_crate_slots_t* slots = &crate->slots[type];
+    slots->storage = arena + slot_offsets[type];
+    slots->stride = VME_CRATE_ALIGN(vme_crate_modules[type].storage_size());
+    slots->capacity = counts[type];
+    slots->regions = (VME_REGION**)(arena + region_offsets[type]);
+  }
+  crate->v210_settle_stats = (v210_settle_stats_t*)(arena + settle_stats_offset);
+  return crate;
+}
+
+void vme_crate_delete(vme_crate_t* restrict crate) {
+  if (crate == NULL) return;
+  for (int type = 0; type < VME_CRATE_TYPE_COUNT; type++) {
+    if (vme_crate_modules[type].release_region == NULL) continue;
+    for (size_t i = 0; i < crate->slots[type].count; i++) {
+      vme_crate_modules[type].release_region(crate->slots[type].regions[i]);
+    }
+  }
+  free(crate);
+}
+
+VME_REGION* vme_crate_add(vme_crate_t* restrict crate, vme_crate_type_t type,
+    const uint32_t vme_addr, const V120_PD addr_mode, const char* restrict name) {
+  if (crate == NULL || type < 0 || type >= VME_CRATE_TYPE_COUNT) return NULL;
+  vme_crate_slots_t* slots = &crate->slots[type];
+  if (slots->count == slots->capacity) {
+    printf("vme_crate_add: No free slot for module at 0x%08X\n", vme_addr);
+    return NULL;
+  }
+
+  void* storage = slots->storage + slots->count * slots->stride;
+  VME_REGION* region = vme_crate_modules[type].add_region_at(crate->hV120, vme_addr, addr_mode,
+      name, storage);
+  if (region == NULL) return NULL;
+  if (type == VME_CRATE_V210) {
+    v210_attach_settle_stats(region, &crate->v210_settle_stats[slots->count * V210_CHANNEL_COUNT]);
+  }
+  slots->regions[slots->count++] = region;
+  return region;
+}
+
+int vme_crate_get_regions(vme_crate_t* restrict crate, vme_crate_type_t type,
+    VME_REGION* const** restrict regions, size_t* restrict count) {
+  if (crate == NULL || regions == NULL || count == NULL) return -1;
+  if (type < 0 || type >= VME_CRATE_TYPE_COUNT) return -1;
+  *regions = crate->slots[type].regions;
+  *count = crate->slots[type].count;
+  return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * Public API for crate contexts.
+ *
+ * A crate context owns one contiguous, cache-aligned arena that holds the VME regions and the
+ * per-module state of every module in a crate, instead of two scattered heap allocations per
+ * module. Each module occupies one cache-aligned slot with its region and hot state side by side,
+ * and the slots of each module type are contiguous, so a poll loop over all modules of a type
+ * walks memory linearly. Cold V210 settle statistics are kept in a separate array at the end of
+ * the arena. Deleting the crate frees the whole arena with a single free().
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Crate Module Type. */
+typedef enum vme_crate_type_t {
+  VME_CRATE_V210 = 0,
+  VME_CRATE_V230 = 1,
+  VME_CRATE_V280 = 2,
+  VME_CRATE_TYPE_COUNT
+} vme_crate_type_t;
+
+/** Crate Context (opaque). */
+typedef struct vme_crate_t vme_crate_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates a crate context with room for the given number of modules of each type.
+ *
+ * @param  hV120      Handle to the V120 library.
+ * @param  v210_count Maximum number of V210 modules.
+ * @param  v230_count Maximum number of V230 modules.
+ * @param  v280_count Maximum number of V280 modules.
+ * @return Pointer to the crate context, or NULL on failure.
+ */
+vme_crate_t* vme_crate_create(
+  V120_HANDLE* restrict hV120,
+  size_t v210_count,
+  size_t v230_count,
+  size_t v280_count
+);
+
+/**
+ * Releases every region of the crate and frees the arena. The regions stay registered with the
+ * V120 handle, so, as with v210_delete_region(), the handle must be closed first.
+ *
+ * @param  crate Crate context to delete.
+ */
+void vme_crate_delete(vme_crate_t* restrict crate);
+
+/**
+ * Adds a VME region for a module in the next free slot of its type.
+ *
+ * @param  crate     Crate context.
+ * @param  type      Module type.
+ * @param  vme_addr  Base address of the module.
+ * @param  addr_mode Addressing mode (A16, A24).
+ * @param  name      Name of the VME region (must outlive the crate).
+ * @return Pointer to the VME region, or NULL on failure (including a full crate).
+ */
+VME_REGION* vme_crate_add(
+  vme_crate_t* restrict crate,
+  vme_crate_type_t type,
+  const uint32_t vme_addr,
+  const V120_PD addr_mode,
+  const char* restrict name
+);
+
+/**
+ * Gets the regions of all modules of one type, in the order they were added. The array lives in
+ * the arena and can be passed directly to v210_matrix_create() or vme_interlock_create().
+ *
+ * @param  crate   Crate context.
+ * @param  type    Module type.
+ * @param  regions Storage for a pointer to the array of regions.
+ * @param  count   Storage for the number of regions.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_crate_get_regions(
+  vme_crate_t* restrict crate,
+  vme_crate_type_t type,
+  VME_REGION* const** restrict regions,
+  size_t* restrict count
+);
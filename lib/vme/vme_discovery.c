@@ -0,0 +1,275 @@
+/**
+ * Implementation of the Crate Discovery.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "v210_reg.h"
+#include "v230_reg.h"
+#include "v280_reg.h"
+#include "vme_clock.h"
+#include "vme_discovery.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+#define VME_DISCOVERY_A16_SIZE 0x10000U
+#define VME_DISCOVERY_A24_SIZE 0x1000000U
+
+/** Largest probe region; longer A24 ranges are split into several regions. */
+#define VME_DISCOVERY_MAX_REGION_LEN 0x100000U
+
+/** V230 and V280 modules occupy, and are aligned to, one block. */
+#define VME_DISCOVERY_BLOCK_SIZE ((uint32_t)sizeof(v230_registers))
+
+/** V210 modules are aligned to their smaller register map. */
+#define VME_DISCOVERY_V210_STEP ((uint32_t)sizeof(v210_registers))
+
+static_assert(sizeof(v280_registers) == sizeof(v230_registers));
+static_assert(offsetof(v280_registers, vxi_mfr) == offsetof(v230_registers, vxi_mfr));
+static_assert(offsetof(v280_registers, vxi_type) == offsetof(v230_registers, vxi_type));
+static_assert(offsetof(v280_registers, serial) == offsetof(v230_registers, serial));
+static_assert(offsetof(v280_registers, rom_rev) == offsetof(v230_registers, rom_rev));
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Discovery in progress. */
+typedef struct vme_discovery_context_t {
+  vme_discovery_module_t* modules;
+  size_t max_modules;
+  size_t count;
+  vme_discovery_stats_t stats;
+} vme_discovery_context_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/** Jump target of the probe read in progress on this thread, or NULL. */
+static __thread sigjmp_buf* volatile vme_discovery_jump = NULL;
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+/**
+ * SIGBUS handler: abandons the probe read in progress. A SIGBUS outside a probe read gets the
+ * default action when the faulting access is retried.
+ *
+ * @param  sig Signal number.
+ */
+static void vme_discovery_sigbus(int sig) {
+  if (vme_discovery_jump != NULL) siglongjmp(*vme_discovery_jump, 1);
+  signal(sig, SIG_DFL);
+}
+
+/**
+ * Reads one register, absorbing a bus error.
+ *
+ * @param  context Discovery in progress.
+ * @param  base    Host address of the candidate base address.
+ * @param  offset  Register offset.
+ * @param  value   Storage for the register value.
+ * @return 0 on success, -1 on a bus error.
+ */
+static int vme_discovery_read(vme_discovery_context_t* restrict context,
+    volatile uint8_t* base, size_t offset, uint16_t* restrict value) {
+  sigjmp_buf jump;
+  context->stats.probes++;
+  if (sigsetjmp(jump, 1) != 0) {
+    vme_discovery_jump = NULL;
+    context->stats.bus_errors++;
+    return -1;
+  }
+  vme_discovery_jump = &jump;
+  *value = *(volatile uint16_t*)(base + offset);
+  vme_discovery_jump = NULL;
+  return 0;
+}
+
+/**
+ * Probes a candidate base address for a module of the given types.
+ *
+ * @param  context    Discovery in progress.
+ * @param  base       Host address of the candidate base address.
+ * @param  mfr_offset Offset of the vxi_mfr register.
+ * @param  type       Storage for the model type read.
+ * @return true if the candidate holds a Highland module (type is then valid).
+ */
+static bool vme_discovery_probe(vme_discovery_context_t* restrict context,
+    volatile uint8_t* base, size_t mfr_offset, uint16_t* restrict type) {
+  uint16_t mfr;
+  if (vme_discovery_read(context, base, mfr_offset, &mfr) < 0) return false;
+  if (mfr != VME_DISCOVERY_MFR_HIGHLAND) return false;
+  return vme_discovery_read(context, base, mfr_offset + sizeof(uint16_t), type) == 0;
+}
+
+/**
+ * Records a discovered module.
+ *
+ * @param  context Discovery in progress.
+ * @param  module  Module.
+ */
+static void vme_discovery_add(vme_discovery_context_t* restrict context,
+    const vme_discovery_module_t* restrict module) {
+  if (context->count < context->max_modules) context->modules[context->count] = *module;
+  context->count++;
+}
+
+/**
+ * Probes every candidate base address of a mapped region within [start, end). Each block is
+ * probed for a V230 or V280 first; only blocks without one are probed for V210 modules.
+ *
+ * @param  context Discovery in progress.
+ * @param  region  Mapped probe region, aligned to blocks.
+ * @param  start   First address to probe.
+ * @param  end     End of the addresses to probe (exclusive).
+ */
+static void vme_discovery_probe_region(vme_discovery_context_t* restrict context,
+    const VME_REGION* restrict region, uint32_t start, uint32_t end) {
+  const V120_PD addr_mode = ((region->config & V120_A24) == V120_A24) ? V120_A24 : V120_A16;
+  const uint32_t region_end = (uint32_t)(region->vme_addr + region->len);
+  volatile uint8_t* region_base = (volatile uint8_t*)region->base;
+  uint16_t type, value;
+
+  for (uint32_t block = (uint32_t)region->vme_addr; block < region_end;
+      block += VME_DISCOVERY_BLOCK_SIZE) {
+    volatile uint8_t* base = region_base + (block - region->vme_addr);
+    if (block >= start && block < end &&
+        vme_discovery_probe(context, base, offsetof(v230_registers, vxi_mfr), &type) &&
+        (type == VME_DISCOVERY_TYPE_V230 || type == VME_DISCOVERY_TYPE_V280)) {
+      vme_discovery_module_t module = {.vme_addr = block, .addr_mode = addr_mode, .type = type};
+      if (vme_discovery_read(context, base, offsetof(v230_registers, serial), &value) == 0) {
+        module.serial = value;
+      }
+      if (vme_discovery_read(context, base, offsetof(v230_registers, rom_rev), &value) == 0) {
+        module.revision = value;
+      }
+      vme_discovery_add(context, &module);
+      continue;
+    }
+
+    for (uint32_t addr = block; addr < block + VME_DISCOVERY_BLOCK_SIZE;
+        addr += VME_DISCOVERY_V210_STEP) {
+      if (addr < start || addr >= end) continue;
+      base = region_base + (addr - region->vme_addr);
+      if (!vme_discovery_probe(context, base, offsetof(v210_registers, vxi_mfr), &type) ||
+          type != VME_DISCOVERY_TYPE_V210) {
+        continue;
+      }
+      vme_discovery_module_t module = {.vme_addr = addr, .addr_mode = addr_mode, .type = type};
+      if (vme_discovery_read(context, base, offsetof(v210_registers, fpga_rev), &value) == 0) {
+        module.revision = value;
+      }
+      vme_discovery_add(context, &module);
+    }
+  }
+}
+
+int vme_discovery_run(int v120_id, const vme_discovery_options_t* restrict options,
+    vme_discovery_module_t* restrict modules, size_t max_modules, size_t* restrict count,
+    vme_discovery_stats_t* restrict stats) {
+  if (options == NULL || count == NULL || (modules == NULL && max_modules > 0)) return -1;
+  const bool scan_a24 = (options->a24_end != 0);
+  if (scan_a24 && (options->a24_start >= options->a24_end ||
+      options->a24_end > VME_DISCOVERY_A24_SIZE)) {
+    return -1;
+  }
+
+  const uint64_t start_ns = vme_clock_get_time_ns();
+  vme_discovery_context_t context = {.modules = modules, .max_modules = max_modules};
+
+  /** Probe regions cover whole blocks, so a block is never split across two regions. */
+  uint32_t a24_start = 0, a24_end = 0;
+  size_t region_count = options->scan_a16 ? 1 : 0;
+  if (scan_a24) {
+    a24_start = options->a24_start & ~(VME_DISCOVERY_BLOCK_SIZE - 1);
+    a24_end = (options->a24_end + VME_DISCOVERY_BLOCK_SIZE - 1) & ~(VME_DISCOVERY_BLOCK_SIZE - 1);
+    region_count += (a24_end - a24_start + VME_DISCOVERY_MAX_REGION_LEN - 1) /
+        VME_DISCOVERY_MAX_REGION_LEN;
+  }
+  if (region_count == 0) {
+    *count = 0;
+    if (stats != NULL) memset(stats, 0, sizeof(vme_discovery_stats_t));
+    return 0;
+  }
+
+  VME_REGION* regions = calloc(region_count, sizeof(VME_REGION));
+  if (regions == NULL) {
+    printf("vme_discovery_run: Failed to allocate memory for probe regions\n");
+    return -1;
+  }
+  size_t index = 0;
+  if (options->scan_a16) {
+    regions[index].vme_addr = 0;
+    regions[index].len = VME_DISCOVERY_A16_SIZE;
+    regions[index].config = V120_A16 | V120_SMAX | V120_EAUTO | V120_D16;
+    regions[index].tag = "discovery_a16";
+    index++;
+  }
+  for (uint32_t addr = a24_start; scan_a24 && addr < a24_end;
+      addr += VME_DISCOVERY_MAX_REGION_LEN) {
+    const uint32_t len = a24_end - addr;
+    regions[index].vme_addr = addr;
+    regions[index].len = (len < VME_DISCOVERY_MAX_REGION_LEN) ? len : VME_DISCOVERY_MAX_REGION_LEN;
+    regions[index].config = V120_A24 | V120_SMAX | V120_EAUTO | V120_D16;
+    regions[index].tag = "discovery_a24";
+    index++;
+  }
+
+  V120_HANDLE* hV120 = v120_open(v120_id);
+  if (hV120 == NULL) {
+    printf("vme_discovery_run: Failed to open V120 handle\n");
+    free(regions);
+    return -1;
+  }
+  for (size_t i = 0; i < region_count; i++) {
+    if (v120_add_vme_region(hV120, &regions[i]) == NULL) {
+      printf("vme_discovery_run: Failed to add probe region\n");
+      v120_close(hV120);
+      free(regions);
+      return -1;
+    }
+  }
+  if (v120_allocate_vme(hV120, 0) < 0) {
+    printf("vme_discovery_run: Failed to allocate probe regions\n");
+    v120_close(hV120);
+    free(regions);
+    return -1;
+  }
+
+  struct sigaction action, previous;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = vme_discovery_sigbus;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGBUS, &action, &previous);
+
+  for (size_t i = 0; i < region_count; i++) {
+    const bool a16 = options->scan_a16 && i == 0;
+    vme_discovery_probe_region(&context, &regions[i], a16 ? 0 : options->a24_start,
+        a16 ? VME_DISCOVERY_A16_SIZE : options->a24_end);
+  }
+
+  sigaction(SIGBUS, &previous, NULL);
+  v120_close(hV120);
+  free(regions);
+
+  *count = context.count;
+  if (stats != NULL) {
+    context.stats.regions = (uint32_t)region_count;
+    context.stats.elapsed_ns = vme_clock_get_time_ns() - start_ns;
+    *stats = context.stats;
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * Public API for crate discovery.
+ *
+ * Discovery finds the V210, V230 and V280 modules in a crate by probing candidate base addresses
+ * for the Highland VXI manufacturer ID (0xFEEE) and the model types 22210, 22230 and 22280. Each
+ * address space is mapped with as few regions as possible and every candidate is probed with
+ * single register reads, reading the model type and serial number only where the manufacturer ID
+ * matched, so an empty address costs one bus cycle. Bus errors from empty addresses are absorbed.
+ *
+ * Discovery opens its own V120 handle, because probe regions cannot be removed from a handle once
+ * allocated; it must not run while another thread of the process uses the same V120.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Highland Technology VXI manufacturer ID. */
+#define VME_DISCOVERY_MFR_HIGHLAND 0xFEEE
+
+#define VME_DISCOVERY_TYPE_V210 22210
+#define VME_DISCOVERY_TYPE_V230 22230
+#define VME_DISCOVERY_TYPE_V280 22280
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Discovery Options. */
+typedef struct vme_discovery_options_t {
+  bool scan_a16;        /** Probe the whole A16 space. */
+  uint32_t a24_start;   /** First A24 address to probe. */
+  uint32_t a24_end;     /** End of the A24 range to probe (exclusive), or 0 to skip A24. */
+} vme_discovery_options_t;
+
+/** Discovered Module. */
+typedef struct vme_discovery_module_t {
+  uint32_t vme_addr;    /** Base address of the module. */
+  V120_PD addr_mode;    /** Addressing mode (V120_A16, V120_A24). */
+  uint16_t type;        /** VXI model type (VME_DISCOVERY_TYPE_*). */
+  uint16_t serial;      /** Unit serial number (0 for the V210, which has none). */
+  uint16_t revision;    /** Firmware revision (FPGA revision for the V210). */
+} vme_discovery_module_t;
+
+/** Discovery Statistics. */
+typedef struct vme_discovery_stats_t {
+  uint64_t probes;      /** Number of register reads. */
+  uint64_t bus_errors;  /** Number of reads that ended in a bus error. */
+  uint32_t regions;     /** Number of probe regions mapped. */
+  uint64_t elapsed_ns;  /** Duration of the discovery. */
+} vme_discovery_stats_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Discovers the modules in a crate, in address order (A16 first).
+ *
+ * @param  v120_id     V120 controller ID.
+ * @param  options     Discovery options.
+ * @param  modules     Storage for up to max_modules discovered modules.
+ * @param  max_modules Number of modules that fit in modules.
+ * @param  count       Storage for the number of modules found (may exceed max_modules).
+ * @param  stats       Optional storage for the discovery statistics.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_discovery_run(
+  int v120_id,
+  const vme_discovery_options_t* restrict options,
+  vme_discovery_module_t* restrict modules,
+  size_t max_modules,
+  size_t* restrict count,
+  vme_discovery_stats_t* restrict stats
+);
@@ -0,0 +1,370 @@
+/**
+ * Implementation of the V230/V210 Interlock Engine.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "v210.h"
+#include "v230.h"
+#include "vme_clock.h"
+#include "vme_interlock.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/**
+ * Compiled Rule Condition. Both comparisons are folded into "sign * voltage > trip", re-arming on
+ * "sign * voltage < rearm", so the evaluation loop has no per-rule branch on the comparison.
+ */
+typedef struct vme_interlock_condition_t {
+  float sign;
+  float trip;
+  float rearm;
+  uint8_t channel;
+} vme_interlock_condition_t;
+
+/** Interlock Engine. */
+struct vme_interlock_t {
+  V120_HANDLE* hV120;
+  VME_REGION* v230_region;
+  VME_REGION** v210_regions;
+  size_t v210_count;
+
+  /** Rules, in identifier order. */
+  vme_interlock_condition_t* conditions;
+  vme_interlock_rule_t* rules;
+  _Atomic bool* tripped;
+  size_t rule_count;
+  size_t rule_capacity;
+
+  /** Relays to set and clear on each V210, kept until a write of them succeeds. */
+  uint64_t* pending_set;
+  uint64_t* pending_clear;
+  /** Detection time of the scan that first made each output's pending masks non-empty. */
+  uint64_t* pending_detect_ns;
+  /** True if a write failed and its pending masks must be retried on the next scan. */
+  bool retry;
+
+  bool has_scan_count;
+  uint16_t scan_count;
+
+  /** Guards stats. */
+  pthread_mutex_t lock;
+  vme_interlock_stats_t stats;
+
+  pthread_t thread;
+  bool thread_active;
+  atomic_bool stop_requested;
+  uint64_t interval_ns;
+};
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+vme_interlock_t* vme_interlock_create(V120_HANDLE* restrict hV120,
+    VME_REGION* restrict v230_region, VME_REGION* const* restrict v210_regions,
+    size_t v210_count) {
+  if (hV120 == NULL || v230_region == NULL || v210_regions == NULL || v210_count == 0) return NULL;
+  for (size_t i = 0; i < v210_count; i++) {
+    if (v210_regions[i] == NULL) return NULL;
+  }
+
+  vme_interlock_t* interlock = malloc(sizeof(vme_interlock_t));
+  if (interlock == NULL) {
+    printf("vme_interlock_create: Failed to allocate memory for interlock engine\n");
+    return NULL;
+  }
+  memset(interlock, 0, sizeof(vme_interlock_t));
+
+  interlock->v210_regions = malloc(v210_count * sizeof(VME_REGION*));
+  interlock->pending_set = malloc(v210_count * sizeof(uint64_t));
+  interlock->pending_clear = malloc(v210_count * sizeof(uint64_t));
+  interlock->pending_detect_ns = malloc(v210_count * sizeof(uint64_t));
+  if (interlock->v210_regions == NULL || interlock->pending_set == NULL ||
+      interlock->pending_clear == NULL || interlock->pending_detect_ns == NULL) {
+    printf("vme_interlock_create: Failed to allocate memory for outputs\n");
+    free(interlock->v210_regions);
+    free(interlock->pending_set);
+    free(interlock->pending_clear);
+    free(interlock->pending_detect_ns);
+    free(interlock);
+    return NULL;
+  }
+  memcpy(interlock->v210_regions, v210_regions, v210_count * sizeof(VME_REGION*));
+  memset(interlock->pending_set, 0, v210_count * sizeof(uint64_t));
+  memset(interlock->pending_clear, 0, v210_count * sizeof(uint64_t));
+  memset(interlock->pending_detect_ns, 0, v210_count * sizeof(uint64_t));
+
+  interlock->hV120 = hV120;
+  interlock->v230_region = v230_region;
+  interlock->v210_count = v210_count;
+  pthread_mutex_init(&interlock->lock, NULL);
+  atomic_init(&interlock->stop_requested, false);
+  return interlock;
+}
+
+void vme_interlock_delete(vme_interlock_t* restrict interlock) {
+  if (interlock == NULL) return;
+  vme_interlock_stop(interlock);
+  pthread_mutex_destroy(&interlock->lock);
+  free(interlock->conditions);
+  free(interlock->rules);
+  free((void*)interlock->tripped);
+  free(interlock->v210_regions);
+  free(interlock->pending_set);
+  free(interlock->pending_clear);
+  free(interlock->pending_detect_ns);
+  free(interlock);
+}
+
+int vme_interlock_add_rule(vme_interlock_t* restrict interlock,
+    const vme_interlock_rule_t* restrict rule) {
+  if (interlock == NULL || rule == NULL || interlock->thread_active) return -1;
+  if (rule->channel >= V230_NUM_CHANNELS || rule->output >= interlock->v210_count) return -1;
+  if (rule->compare != VME_INTERLOCK_ABOVE && rule->compare != VME_INTERLOCK_BELOW) return -1;
+  if (!(rule->hysteresis_v >= 0.0f) || interlock->rule_count >= INT32_MAX) return -1;
+
+  if (interlock->rule_count == interlock->rule_capacity) {
+    const size_t capacity = (interlock->rule_capacity == 0) ? 16 : 2 * interlock->rule_capacity;
+    vme_interlock_condition_t* conditions = realloc(interlock->conditions,
+        capacity * sizeof(vme_interlock_condition_t));
+    if (conditions != NULL) interlock->conditions = conditions;
+    vme_interlock_rule_t* rules = realloc(interlock->rules,
+        capacity * sizeof(vme_interlock_rule_t));
+    if (rules != NULL) interlock->rules = rules;
+    _Atomic bool* tripped = realloc((void*)interlock->tripped, capacity * sizeof(_Atomic bool));
+    if (tripped != NULL) interlock->tripped = tripped;
+    if (conditions == NULL || rules == NULL || tripped == NULL) {
+      printf("vme_interlock_add_rule: Failed to allocate memory for rules\n");
+      return -1;
+    }
+    interlock->rule_capacity = capacity;
+  }
+
+  const size_t id = interlock->rule_count++;
+  const float sign = (rule->compare == VME_INTERLOCK_ABOVE) ? 1.0f : -1.0f;
+  interlock->conditions[id] = (vme_interlock_condition_t){
+    .sign = sign,
+    .trip = sign * rule->threshold_v,
+    .rearm = sign * rule->threshold_v - rule->hysteresis_v,
+    .channel = rule->channel,
+  };
+  interlock->rules[id] = *rule;
+  atomic_init(&interlock->tripped[id], false);
+  return (int)id;
+}
+
+/**
+ * Gets the latency histogram bin of a latency.
+ *
+ * @param  latency_ns Latency in nanoseconds.
+ * @return Bin index (floor of log2, 0 for 0 and 1).
+ */
+static inline uint32_t vme_interlock_histogram_bin(uint64_t latency_ns) {
+  return 63U - (uint32_t)__builtin_clzll(latency_ns | 1);
+}
+
+int vme_interlock_process(vme_interlock_t* restrict interlock,
+    const v230_channel_voltage_t* restrict voltages, uint64_t detect_ns) {
+  if (interlock == NULL || voltages == NULL) return -1;
+
+  /** Evaluate every rule first, so all writes of one scan are issued back to back. */
+  uint32_t trips = 0;
+  for (size_t i = 0; i < interlock->rule_count; i++) {
+    const vme_interlock_condition_t* condition = &interlock->conditions[i];
+    const float value = condition->sign * voltages->voltage[condition->channel];
+    const bool tripped = atomic_load_explicit(&interlock->tripped[i], memory_order_relaxed);
+    if (!tripped && value > condition->trip) {
+      const vme_interlock_rule_t* rule = &interlock->rules[i];
+      if ((interlock->pending_set[rule->output] | interlock->pending_clear[rule->output]) == 0) {
+        interlock->pending_detect_ns[rule->output] = detect_ns;
+      }
+      interlock->pending_set[rule->output] |= rule->set_mask;
+      interlock->pending_clear[rule->output] |= rule->clear_mask;
+      atomic_store_explicit(&interlock->tripped[i], true, memory_order_relaxed);
+      trips++;
+    } else if (tripped && value < condition->rearm) {
+      atomic_store_explicit(&interlock->tripped[i], false, memory_order_relaxed);
+    }
+  }
+
+  /**
+   * A failed write keeps its pending masks, so the action is retried on every scan until done.
+   * Latency runs from the scan that first required the oldest write, not from the retrying scan.
+   */
+  uint64_t writes = 0, errors = 0;
+  uint64_t first_detect_ns = detect_ns;
+  if (trips > 0 || interlock->retry) {
+    for (size_t output = 0; output < interlock->v210_count; output++) {
+      const uint64_t set = interlock->pending_set[output];
+      const uint64_t clear = interlock->pending_clear[output];
+      if ((set | clear) == 0) continue;
+
+      VME_REGION* region = interlock->v210_regions[output];
+      uint64_t mask;
+      if (v210_get_commanded_relays(region, &mask) < 0 ||
+          v210_update_relays(region, (mask | set) & ~clear) < 0) {
+        errors++;
+      } else {
+        interlock->pending_set[output] = 0;
+        interlock->pending_clear[output] = 0;
+        if (interlock->pending_detect_ns[output] < first_detect_ns) {
+          first_detect_ns = interlock->pending_detect_ns[output];
+        }
+        writes++;
+      }
+    }
+    interlock->retry = (errors > 0);
+  }
+  const uint64_t latency_ns = vme_clock_get_time_ns() - first_detect_ns;
+
+  pthread_mutex_lock(&interlock->lock);
+  interlock->stats.scans++;
+  interlock->stats.trips += trips;
+  interlock->stats.writes += writes;
+  interlock->stats.errors += errors;
+  if (writes > 0) {
+    interlock->stats.latency_histogram[vme_interlock_histogram_bin(latency_ns)]++;
+    if (latency_ns > interlock->stats.max_latency_ns) interlock->stats.max_latency_ns = latency_ns;
+  }
+  pthread_mutex_unlock(&interlock->lock);
+  return (errors > 0) ? -1 : (int)trips;
+}
+
+/**
+ * Counts a failed read.
+ *
+ * @param  interlock Interlock engine.
+ * @return -1.
+ */
+static int vme_interlock_read_failed(vme_interlock_t* restrict interlock) {
+  pthread_mutex_lock(&interlock->lock);
+  interlock->stats.errors++;
+  pthread_mutex_unlock(&interlock->lock);
+  return -1;
+}
+
+int vme_interlock_poll(vme_interlock_t* restrict interlock) {
+  if (interlock == NULL) return -1;
+
+  uint16_t scan_count;
+  if (v230_get_scan_count(interlock->v230_region, &scan_count) < 0) {
+    return vme_interlock_read_failed(interlock);
+  }
+  const uint64_t detect_ns = vme_clock_get_time_ns();
+  const uint16_t advanced = (uint16_t)(scan_count - interlock->scan_count);
+  const bool fresh = !interlock->has_scan_count || advanced != 0;
+  if (interlock->has_scan_count && advanced > 1) {
+    pthread_mutex_lock(&interlock->lock);
+    interlock->stats.missed_scans += advanced - 1U;
+    pthread_mutex_unlock(&interlock->lock);
+  }
+  interlock->scan_count = scan_count;
+  interlock->has_scan_count = true;
+  if (!fresh) return 0;
+
+  v230_channel_voltage_t voltages;
+  if (v230_get_all_channel_voltages(interlock->hV120, interlock->v230_region, &voltages) < 0) {
+    return vme_interlock_read_failed(interlock);
+  }
+  return vme_interlock_process(interlock, &voltages, detect_ns);
+}
+
+/**
+ * Acquisition thread: calls vme_interlock_poll() on an absolute-deadline schedule until stopped.
+ *
+ * @param  arg Interlock engine.
+ * @return NULL.
+ */
+static void* vme_interlock_run(void* arg) {
+  vme_interlock_t* interlock = (vme_interlock_t*)arg;
+  uint64_t deadline_ns = vme_clock_get_time_ns();
+  while (!atomic_load_explicit(&interlock->stop_requested, memory_order_relaxed)) {
+    vme_interlock_poll(interlock);
+    deadline_ns += interlock->interval_ns;
+    uint64_t now_ns = vme_clock_get_time_ns();
+    if (deadline_ns < now_ns) deadline_ns = now_ns;
+    struct timespec deadline = {
+      .tv_sec = (time_t)(deadline_ns / 1000000000ULL),
+      .tv_nsec = (long)(deadline_ns % 1000000000ULL),
+    };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+  }
+  return NULL;
+}
+
+int vme_interlock_start(vme_interlock_t* restrict interlock, uint32_t interval_us, int priority) {
+  if (interlock == NULL || interlock->thread_active || interval_us == 0 || priority < 0) return -1;
+  interlock->interval_ns = (uint64_t)interval_us * 1000ULL;
+  atomic_store(&interlock->stop_requested, false);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  if (priority > 0) {
+    struct sched_param param = {.sched_priority = priority};
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+  }
+  int status = pthread_create(&interlock->thread, &attr, vme_interlock_run, interlock);
+  pthread_attr_destroy(&attr);
+  if (status != 0) {
+    printf("vme_interlock_start: Failed to create acquisition thread\n");
+    return -1;
+  }
+  interlock->thread_active = true;
+  return 0;
+}
+
+int vme_interlock_stop(vme_interlock_t* restrict interlock) {
+  if (interlock == NULL) return -1;
+  if (!interlock->thread_active) return 0;
+  atomic_store(&interlock->stop_requested, true);
+  if (pthread_join(interlock->thread, NULL) != 0) return -1;
+  interlock->thread_active = false;
+  return 0;
+}
+
+int vme_interlock_is_tripped(vme_interlock_t* restrict interlock, uint32_t rule,
+    bool* restrict tripped) {
+  if (interlock == NULL || tripped == NULL || rule >= interlock->rule_count) return -1;
+  *tripped = atomic_load_explicit(&interlock->tripped[rule], memory_order_relaxed);
+  return 0;
+}
+
+int vme_interlock_get_stats(vme_interlock_t* restrict interlock,
+    vme_interlock_stats_t* restrict stats) {
+  if (interlock == NULL || stats == NULL) return -1;
+  pthread_mutex_lock(&interlock->lock);
+  *stats = interlock->stats;
+  pthread_mutex_unlock(&interlock->lock);
+  return 0;
+}
+
+int vme_interlock_reset_stats(vme_interlock_t* restrict interlock) {
+  if (interlock == NULL) return -1;
+  pthread_mutex_lock(&interlock->lock);
+  memset(&interlock->stats, 0, sizeof(vme_interlock_stats_t));
+  pthread_mutex_unlock(&interlock->lock);
+  return 0;
+}
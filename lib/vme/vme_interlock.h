@@ -0,0 +1,193 @@
+/**
+ * Public API for V230 to V210 interlocks.
+ *
+ * An interlock engine evaluates a set of compiled threshold rules, such as "channel 12 above 9 V
+ * sets relays 0 - 7", against every fresh V230 scan and issues the resulting V210 writes directly
+ * from the acquisition thread, without a round trip through application code. A rule trips once
+ * when its condition becomes true and re-arms when the value moves back past the threshold by the
+ * hysteresis; tripping never undoes itself.
+ *
+ * The time from noticing a fresh scan to completing the relay writes is recorded in a log2
+ * histogram, so the worst-case reaction time can be demonstrated from the field data. A write
+ * that fails is retried on every following scan until it succeeds.
+ *
+ * The engine writes the V210 modules through their unlocked relay shadow, wear counters and
+ * journal. While it runs, it owns those modules exclusively: the application must not change
+ * their relays from any other thread.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+#include "v230.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Number of latency histogram bins; bin k counts latencies in [2^k, 2^(k+1)) ns (bin 0: 0-1). */
+#define VME_INTERLOCK_HISTOGRAM_BINS 64
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Interlock Comparison. */
+typedef enum vme_interlock_compare_t {
+  VME_INTERLOCK_ABOVE = 0,  /** Trips when the voltage exceeds the threshold. */
+  VME_INTERLOCK_BELOW = 1,  /** Trips when the voltage falls below the threshold. */
+} vme_interlock_compare_t;
+
+/** Interlock Rule. */
+typedef struct vme_interlock_rule_t {
+  uint8_t channel;                  /** V230 channel (0 - 63). */
+  vme_interlock_compare_t compare;  /** Comparison against the threshold. */
+  float threshold_v;                /** Trip threshold in volts. */
+  float hysteresis_v;               /** Distance back past the threshold that re-arms the rule. */
+  uint16_t output;                  /** Index of the V210 module to write. */
+  uint64_t set_mask;                /** Relays to set when the rule trips. */
+  uint64_t clear_mask;              /** Relays to clear when the rule trips (wins over set). */
+} vme_interlock_rule_t;
+
+/** Interlock Statistics. */
+typedef struct vme_interlock_stats_t {
+  uint64_t scans;           /** Number of scans evaluated. */
+  uint64_t missed_scans;    /** Scans that completed between two polls and were never read. */
+  uint64_t trips;           /** Number of rule trips. */
+  uint64_t writes;          /** Number of V210 updates issued. */
+  uint64_t errors;          /** Number of failed reads or writes. */
+  uint64_t max_latency_ns;  /** Longest detection-to-write latency, retries included. */
+  /** Detection-to-write latencies, measured from the scan that first required the write. */
+  uint64_t latency_histogram[VME_INTERLOCK_HISTOGRAM_BINS];
+} vme_interlock_stats_t;
+
+/** Interlock Engine (opaque). */
+typedef struct vme_interlock_t vme_interlock_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Creates an interlock engine. The regions remain owned by the caller.
+ *
+ * @param  hV120        Handle to the V120 library.
+ * @param  v230_region  VME region of the V230 module that is monitored.
+ * @param  v210_regions VME regions of the V210 modules that rules write (copied).
+ * @param  v210_count   Number of V210 modules.
+ * @return Pointer to the interlock engine, or NULL on failure.
+ */
+vme_interlock_t* vme_interlock_create(
+  V120_HANDLE* restrict hV120,
+  VME_REGION* restrict v230_region,
+  VME_REGION* const* restrict v210_regions,
+  size_t v210_count
+);
+
+/**
+ * Stops the acquisition thread if it is running and deletes the interlock engine.
+ *
+ * @param  interlock Interlock engine to delete.
+ */
+void vme_interlock_delete(vme_interlock_t* restrict interlock);
+
+/**
+ * Adds a rule. Rules can only be added while the acquisition thread is stopped.
+ *
+ * @param  interlock Interlock engine.
+ * @param  rule      Rule to add.
+ * @return Rule identifier (0, 1, ...) on success, -1 on failure.
+ */
+int vme_interlock_add_rule(
+  vme_interlock_t* restrict interlock,
+  const vme_interlock_rule_t* restrict rule
+);
+
+/**
+ * Evaluates all rules against one scan and issues the writes of the rules that trip, along with
+ * any writes that failed on earlier scans.
+ *
+ * @param  interlock Interlock engine.
+ * @param  voltages  Voltages of all channels.
+ * @param  detect_ns CLOCK_MONOTONIC time at which the scan was noticed, for the latency histogram.
+ * @return Number of rules tripped, or -1 on failure.
+ */
+int vme_interlock_process(
+  vme_interlock_t* restrict interlock,
+  const v230_channel_voltage_t* restrict voltages,
+  uint64_t detect_ns
+);
+
+/**
+ * Reads the V230 scan counter and, if a fresh scan is available, fetches and processes it. Must
+ * not be called while the acquisition thread runs.
+ *
+ * @param  interlock Interlock engine.
+ * @return Number of rules tripped (0 if there was no fresh scan), or -1 on failure.
+ */
+int vme_interlock_poll(vme_interlock_t* restrict interlock);
+
+/**
+ * Starts an acquisition thread that calls vme_interlock_poll() periodically.
+ *
+ * @param  interlock   Interlock engine.
+ * @param  interval_us Poll period in microseconds.
+ * @param  priority    SCHED_FIFO priority of the thread, or 0 for the default scheduling policy.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_interlock_start(vme_interlock_t* restrict interlock, uint32_t interval_us, int priority);
+
+/**
+ * Stops the acquisition thread and waits for it to exit.
+ *
+ * @param  interlock Interlock engine.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_interlock_stop(vme_interlock_t* restrict interlock);
+
+/**
+ * Gets whether a rule is currently tripped (its condition has held since it last tripped).
+ *
+ * @param  interlock Interlock engine.
+ * @param  rule      Rule identifier.
+ * @param  tripped   Storage for the state of the rule.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_interlock_is_tripped(
+  vme_interlock_t* restrict interlock,
+  uint32_t rule,
+  bool* restrict tripped
+);
+
+/**
+ * Gets the interlock statistics.
+ *
+ * @param  interlock Interlock engine.
+ * @param  stats     Storage for the statistics.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_interlock_get_stats(
+  vme_interlock_t* restrict interlock,
+  vme_interlock_stats_t* restrict stats
+);
+
+/**
+ * Resets the interlock statistics.
+ *
+ * @param  interlock Interlock engine.
+ * @return 0 on success, non-zero on failure.
+ */
+int vme_interlock_reset_stats(vme_interlock_t* restrict interlock);
@@ -0,0 +1,89 @@
+/**
+ * Implementation of the V210/V230 Scan-Matrix Measurement.
+ */
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "v210.h"
+#include "v230.h"
+#include "vme_clock.h"
+#include "vme_scan_matrix.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/** Number of scan counter increments that guarantee one complete scan after settling. */
+#define VME_SCAN_MATRIX_FRESH_SCANS 2
+
+/** Interval between scan counter polls. */
+#define VME_SCAN_MATRIX_POLL_INTERVAL_NS 50000L
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * IMPLEMENTATION
+ **************************************************************************************************/
+
+/**
+ * Waits until the V230 has completed a full scan started after this call.
+ *
+ * @param  v230_region VME region of the V230 module.
+ * @param  timeout_us  Maximum time to wait, in microseconds.
+ * @return 0 on success, -1 on failure, -2 on timeout.
+ */
+static int vme_scan_matrix_wait_for_scan(VME_REGION* restrict v230_region, uint32_t timeout_us) {
+  const uint64_t deadline_ns = vme_clock_get_time_ns() + (uint64_t)timeout_us * 1000ULL;
+  const struct timespec poll_interval = {0, VME_SCAN_MATRIX_POLL_INTERVAL_NS};
+  uint16_t start_count, scan_count;
+  if (v230_get_scan_count(v230_region, &start_count) < 0) return -1;
+  for (;;) {
+    if (v230_get_scan_count(v230_region, &scan_count) < 0) return -1;
+    if ((uint16_t)(scan_count - start_count) >= VME_SCAN_MATRIX_FRESH_SCANS) return 0;
+    if (vme_clock_get_time_ns() >= deadline_ns) return -2;
+    nanosleep(&poll_interval, NULL);
+  }
+}
+
+int vme_scan_matrix_run(V120_HANDLE* restrict hV120, VME_REGION* restrict v210_region,
+    VME_REGION* restrict v230_region, const uint64_t* restrict step_masks, size_t step_count,
+    const vme_scan_matrix_options_t* restrict options, float* restrict results,
+    uint64_t* restrict settle_ns) {
+  if (hV120 == NULL || v210_region == NULL || v230_region == NULL) return -1;
+  if (step_masks == NULL || options == NULL || results == NULL) return -1;
+
+  v230_channel_voltage_t voltages;
+  bool step_commanded = false;
+  for (size_t step = 0; step < step_count; step++) {
+    if (!step_commanded && v210_update_relays(v210_region, step_masks[step]) < 0) return -1;
+
+    uint64_t step_settle_ns;
+    int status = v210_verify_relays(v210_region, options->settle_timeout_us, &step_settle_ns);
+    if (settle_ns != NULL) settle_ns[step] = step_settle_ns;
+    if (status != 0) return status;
+
+    status = vme_scan_matrix_wait_for_scan(v230_region, options->scan_timeout_us);
+    if (status != 0) return status;
+
+    /** The relays take longer to actuate than the fetch, so the next step can start first. */
+    step_commanded = options->overlap_fetch && (step + 1 < step_count);
+    if (step_commanded && v210_update_relays(v210_region, step_masks[step + 1]) < 0) return -1;
+
+    if (v230_get_all_channel_voltages(hV120, v230_region, &voltages) < 0) return -1;
+    memcpy(&results[step * V230_NUM_CHANNELS], voltages.voltage, sizeof(voltages.voltage));
+  }
+
+  return 0;
+}
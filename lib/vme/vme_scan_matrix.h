@@ -0,0 +1,76 @@
+/**
+ * Public API for scan-matrix measurements: stepping a V210 through a list of relay states and
+ * collecting a V230 scan of all channels at each step.
+ */
+
+#pragma once
+
+/***************************************************************************************************
+ * INCLUDES
+ **************************************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <V120.h>
+
+#include "v230.h"
+
+/***************************************************************************************************
+ * DEFINES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * TYPES
+ **************************************************************************************************/
+
+/** Scan-Matrix Options. */
+typedef struct vme_scan_matrix_options_t {
+  /** Maximum time to wait for the relay contacts to match each step. */
+  uint32_t settle_timeout_us;
+  /** Maximum time to wait for a complete V230 scan after the relays settle. */
+  uint32_t scan_timeout_us;
+  /**
+   * If true, the next step is commanded as soon as the current step's scan completes and before
+   * its data is fetched. Only valid if the measured channels are unaffected by the relays for
+   * longer than the fetch takes (a single DMA transfer), which holds when relay actuation time
+   * exceeds the transfer time and no relay switches a measured signal electronically.
+   */
+  bool overlap_fetch;
+} vme_scan_matrix_options_t;
+
+/***************************************************************************************************
+ * VARIABLES
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * FUNCTIONS
+ **************************************************************************************************/
+
+/**
+ * Runs a scan-matrix measurement. At each step the V210 relays are set to the step mask (writing
+ * only the changed ctl[] words), the contacts are verified against rcon[] so the measured settle
+ * time is used instead of a fixed delay, the V230 is allowed to complete one full scan after
+ * settling, and all channel voltages are fetched with one DMA transfer.
+ *
+ * @param  hV120       Handle to the V120 library.
+ * @param  v210_region VME region of the V210 module.
+ * @param  v230_region VME region of the V230 module.
+ * @param  step_masks  V210 relay mask of each step.
+ * @param  step_count  Number of steps.
+ * @param  options     Scan-matrix options.
+ * @param  results     Storage for step_count * V230_NUM_CHANNELS voltages, step-major.
+ * @param  settle_ns   Optional storage for the measured settle time of each step.
+ * @return 0 on success, -1 on failure, -2 if a step timed out (results up to that step are valid).
+ */
+int vme_scan_matrix_run(
+  V120_HANDLE* restrict hV120,
+  VME_REGION* restrict v210_region,
+  VME_REGION* restrict v230_region,
+  const uint64_t* restrict step_masks,
+  size_t step_count,
+  const vme_scan_matrix_options_t* restrict options,
+  float* restrict results,
+  uint64_t* restrict settle_ns
+);